@@ -1,4 +1,5 @@
 #include "Blackout3D.h"
+#include "PhaseTimer.h"
 
 Blackout3D::Blackout3D() : CubeApplication(20){
 
@@ -6,6 +7,9 @@ Blackout3D::Blackout3D() : CubeApplication(20){
 
 bool Blackout3D::loop() {
     clear();
-    render();
+    {
+        PHASE_TIMER("render");
+        render();
+    }
     return true;
 }
\ No newline at end of file
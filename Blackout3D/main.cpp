@@ -1,10 +1,13 @@
 #include "Blackout3D.h"
+#include "HeadlessRunner.h"
 
 
 int main(int argc, char *argv[]) {
     Blackout3D App1;
-    App1.start();
+    if (!HeadlessRunner::runFromEnvironment(App1)) {
+        App1.start();
 
-    while(1) sleep(1);
+        while(1) sleep(1);
+    }
     return 0;
 }
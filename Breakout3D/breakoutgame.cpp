@@ -1,4 +1,8 @@
 #include "breakoutgame.h"
+#include "InputLog.h"
+#include "CubeTopology.h"
+#include "FastRandom.h"
+#include "PhaseTimer.h"
 #include <stdio.h>
 #include <algorithm>
 #include <iterator>
@@ -8,9 +12,8 @@
 #include <iostream>
 #include <fstream>
 
-BreakoutGame::BreakoutGame() : CubeApplication(40){
+BreakoutGame::BreakoutGame() : CubeApplication(40), highScores_(DEFAULTHIGHSCOREFILE){
   reset();
-  updateHighScoreFromToFile();
 }
 
 void BreakoutGame::reset(int gameDuration){
@@ -20,8 +23,8 @@ void BreakoutGame::reset(int gameDuration){
   balls_.clear();
   blocks_.clear();
   joysticks_.clear();
-  joysticks_.push_back(new Joystick(0));
-  joysticks_.push_back(new Joystick(1));
+  joysticks_.push_back(JoystickInput::create(0));
+  joysticks_.push_back(JoystickInput::create(1));
   players_.push_back(new Player(this, 0, joysticks_[0]));
   players_.push_back(new Player(this, 1, joysticks_[1]));
   spawnBallForPlayer(0);
@@ -57,6 +60,7 @@ BreakoutGame::Player * BreakoutGame::getLeadingPlayer(){
 }
 
 void BreakoutGame::ballLoop(){
+  PHASE_TIMER("ballLoop");
   for(auto ball : balls_){
     ball->step();
     ball->render();
@@ -73,6 +77,7 @@ void BreakoutGame::ballLoop(){
 }
 
 void BreakoutGame::blockLoop(){
+  PHASE_TIMER("blockLoop");
   for(auto block : blocks_){
     block->render();
     for(auto ball : balls_){
@@ -119,6 +124,7 @@ void BreakoutGame::blockLoop(){
 }
 
 void BreakoutGame::playerLoop(){
+  PHASE_TIMER("playerLoop");
   for(auto player : players_){
     player->step();
     player->render();
@@ -127,7 +133,7 @@ void BreakoutGame::playerLoop(){
 //        soundPlayer_.playGameSound(0);
         Vector3f collisionVector = ball->iPosition().cast<float>() - player->centerPosition().cast<float>(); //Vector3f(0,0,-8)
         collisionVector[2] = -15; //to always be upward facing
-        switch(getScreenNumber(ball->iPosition())){
+        switch(CubeTopology::screenNumber(ball->iPosition())){
           case front:
           case back:
             collisionVector[1] = 0;
@@ -162,6 +168,7 @@ bool BreakoutGame::loop(){
   static int postgameCounter = 0;
   static int scrNrCounter = 0;
   static bool isHighScore = false;
+  InputFrame::beginFrame();
 
   switch(gameState_){
     case pregame:
@@ -176,7 +183,7 @@ bool BreakoutGame::loop(){
         drawText((ScreenNumber)i, Vector2i(CharacterBitmaps::centered, 20), Color::white(), playtext);
         drawText((ScreenNumber)i, Vector2i(CharacterBitmaps::centered, 30), Color::white()*0.5, rbutton);
         drawText((ScreenNumber)i, Vector2i(CharacterBitmaps::centered, 36), Color::white()*0.5, bbutton);
-        drawText((ScreenNumber)i, Vector2i(CharacterBitmaps::right, 58), Color::white()*0.5, std::to_string(currentHighScore));
+        drawText((ScreenNumber)i, Vector2i(CharacterBitmaps::right, 58), Color::white()*0.5, std::to_string(highScores_.best()));
       }
       for(auto joystick : joysticks_){
         if(joystick->getButtonPress(0)){
@@ -203,16 +210,19 @@ bool BreakoutGame::loop(){
         ball->render();
 
       scrNrCounter = 0;
-      for(auto player : players_){
-        drawText((ScreenNumber)scrNrCounter, Vector2i(0,58), player->color(), std::to_string(player->getId()) + ": ");
-        drawText((ScreenNumber)scrNrCounter, Vector2i(8,58), Color::white(), std::to_string(player->score()));
-        drawText((ScreenNumber)(scrNrCounter+2), Vector2i(0,58), player->color(), std::to_string(player->getId()) + ": ");
-        drawText((ScreenNumber)(scrNrCounter+2), Vector2i(8,58), Color::white(), std::to_string(player->score()));
-        scrNrCounter++;
-      }
+      {
+        PHASE_TIMER("drawText");
+        for(auto player : players_){
+          drawText((ScreenNumber)scrNrCounter, Vector2i(0,58), player->color(), std::to_string(player->getId()) + ": ");
+          drawText((ScreenNumber)scrNrCounter, Vector2i(8,58), Color::white(), std::to_string(player->score()));
+          drawText((ScreenNumber)(scrNrCounter+2), Vector2i(0,58), player->color(), std::to_string(player->getId()) + ": ");
+          drawText((ScreenNumber)(scrNrCounter+2), Vector2i(8,58), Color::white(), std::to_string(player->score()));
+          scrNrCounter++;
+        }
 
-      drawText(front, Vector2i(CharacterBitmaps::right, 58), Color::white(), std::to_string(remainingSeconds_));
-      drawText(back, Vector2i(CharacterBitmaps::right, 58), Color::white(), std::to_string(remainingSeconds_));
+        drawText(front, Vector2i(CharacterBitmaps::right, 58), Color::white(), std::to_string(remainingSeconds_));
+        drawText(back, Vector2i(CharacterBitmaps::right, 58), Color::white(), std::to_string(remainingSeconds_));
+      }
 
       if(loopcount%getFps() == 0)
         remainingSeconds_--;
@@ -221,6 +231,8 @@ bool BreakoutGame::loop(){
       if(remainingSeconds_ < 0){
         gameState_ = postgame;
         postgameCounter = 10;
+        //entered once per game, the store writes it in the background
+        isHighScore = highScores_.submit(getLeadingPlayer()->score());
       }
 
       //reset game
@@ -245,13 +257,8 @@ bool BreakoutGame::loop(){
         std::string topstring = "PLAYER " + std::to_string(getLeadingPlayer()->getId()) + " WON";
         drawText(top, Vector2i(CharacterBitmaps::centered,CharacterBitmaps::centered), getLeadingPlayer()->color(), topstring);
       }
-      if(loopcount/2%2 == 0){
-          if (updateHighScoreFromToFile(getLeadingPlayer()->score())) {
-              isHighScore = true;
-          }
-          if(isHighScore)
-              drawText(top, Vector2i(CharacterBitmaps::centered,20), Color::white(), "NEW HIGHSCORE");
-      }
+      if(loopcount/2%2 == 0 && isHighScore)
+          drawText(top, Vector2i(CharacterBitmaps::centered,20), Color::white(), "NEW HIGHSCORE");
       if(loopcount%(getFps()/4) == 0)
         postgameCounter--;
       if(postgameCounter < 0){
@@ -263,43 +270,14 @@ bool BreakoutGame::loop(){
 
   // if(loopcount % getFps() == 0)
   //   std::cout << "load: " << getLoad() << std::endl;
-  render();
+  {
+    PHASE_TIMER("render");
+    render();
+  }
   loopcount++;
   return true;
 }
 
-bool BreakoutGame::updateHighScoreFromToFile(int score, std::string filename) {
-    bool returnValue = false;
-    std::ifstream configFileReadStream(filename);
-
-    std::fstream highScoreFile;
-    highScoreFile.open(filename.data(), std::fstream::binary | std::fstream::in);
-    if (highScoreFile) {
-        highScoreFile >> currentHighScore;
-        std::cout << "file open successful, highscore: " << currentHighScore << std::endl;
-    } else {
-        //create file
-        highScoreFile.open(filename.data(),
-                           std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-        highScoreFile << 0;
-        std::cout << "file created successful" << std::endl;
-    }
-
-    if (score > currentHighScore) {
-        std::cout << "NEW HIGHSCORE: " << score << std::endl;
-        currentHighScore = score;
-        returnValue = true;
-
-        highScoreFile.close();
-        highScoreFile.open(filename.data(),
-                           std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-        highScoreFile << currentHighScore;
-    }
-
-    highScoreFile.close();
-    return returnValue;
-}
-
 bool BreakoutGame::isBlockAtPoint(Vector3f point){
   bool result = false;
   for(auto block : blocks_){
@@ -309,7 +287,7 @@ bool BreakoutGame::isBlockAtPoint(Vector3f point){
   return result;
 }
 
-BreakoutGame::Player::Player(CubeApplication * renderCube, int id, Joystick * joystick){
+BreakoutGame::Player::Player(CubeApplication * renderCube, int id, JoystickInput * joystick){
   score_ = 0;
   id_ = id;
   ca_ = renderCube;
@@ -346,7 +324,7 @@ void BreakoutGame::Player::step(){
       }
       if(joystick_->getButtonPress(1)
           && score_ > 100
-          && ca_->getScreenNumber(lastBall_->iPosition()) != top
+          && CubeTopology::screenNumber(lastBall_->iPosition()) != top
           && !ca_->isOnEdge(lastBall_->iPosition())
           && (lastBall_->velocity()[0] != 0 || lastBall_->velocity()[1] != 0 || lastBall_->velocity()[2] > 0)){
         lastBall_->velocity(Vector3f(0,0,-1));
@@ -365,17 +343,18 @@ void BreakoutGame::Player::step(){
 void BreakoutGame::Player::doKIMove(){
   if(lastBall_ != NULL){
     Vector3i BallPos = lastBall_->iPosition();
+    ScreenNumber ballScreen = CubeTopology::screenNumber(BallPos);
     int xPosBall = 0;
-    if(ca_->getScreenNumber(BallPos) == front)
+    if(ballScreen == front)
       xPosBall = BallPos[0];
-    else if(ca_->getScreenNumber(BallPos) == right)
+    else if(ballScreen == right)
       xPosBall = BallPos[1] + CUBESIZE;
-    else if(ca_->getScreenNumber(BallPos) == back)
+    else if(ballScreen == back)
       xPosBall = CUBESIZE - BallPos[0] + 128;
-    else if(ca_->getScreenNumber(BallPos) == left)
+    else if(ballScreen == left)
       xPosBall = CUBESIZE - BallPos[1] + CUBESIZE + 128;
     //randomize xPosBall
-    xPosBall += 10-rand()%20;
+    xPosBall += 10-FastRandom::below(20);
     if(xPosBall < pos_)
       vel_ = -1;
     else if(xPosBall > pos_)
@@ -479,7 +458,7 @@ Color BreakoutGame::Player::color(){
   return color_;
 }
 
-Joystick * BreakoutGame::Player::joystick(){
+JoystickInput * BreakoutGame::Player::joystick(){
   return joystick_;
 }
 
@@ -517,7 +496,7 @@ void BreakoutGame::Ball::step(){
       position_[i] = constrain(position_[i], 0.0f, (float)VIRTUALCUBEMAXINDEX);
 
     Vector3i currentPosition = iPosition();
-    EdgeNumber currentEdge = ca_->getEdgeNumber(currentPosition);
+    EdgeNumber currentEdge = CubeTopology::edgeNumber(currentPosition);
 
     if(currentEdge != anyEdge ){
       if(currentEdge != lastEdge_){
@@ -560,7 +539,7 @@ void BreakoutGame::Ball::step(){
   }else{ //isDead == TRUE
     //red line at the bottom as dying animation
     if(respawnTimer_ % 2 == 0 && respawnTimer_ > ca_->getFps()){
-      switch (ca_->getEdgeNumber(iPosition())) {
+      switch (CubeTopology::edgeNumber(iPosition())) {
         case bottomFront:
           ca_->drawLine3D(Vector3i(0,0,CUBESIZE),Vector3i(CUBESIZE,0,CUBESIZE), Color::red());
         break;
@@ -582,7 +561,7 @@ void BreakoutGame::Ball::step(){
       reset();
 
     // countdown timer for ball respawn
-    ca_->drawText(ca_->getScreenNumber(defaultPosition_.cast<int>()), Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), Color::white(), std::to_string((int)(respawnTimer_/ca_->getFps())+1));
+    ca_->drawText(CubeTopology::screenNumber(defaultPosition_.cast<int>()), Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), Color::white(), std::to_string((int)(respawnTimer_/ca_->getFps())+1));
   }
 }
 
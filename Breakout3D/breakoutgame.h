@@ -3,7 +3,8 @@
 
 #include <CubeApplication.h>
 
-#include <Joystick.h>
+#include "JoystickInput.h"
+#include "HighScoreStore.h"
 //#include "aplay.h"
 
 #define DEFAULTGAMEDURATION 120
@@ -40,21 +41,19 @@ public:
     Player *getLeadingPlayer();
 
 private:
-    bool updateHighScoreFromToFile(int score = 0, std::string filename = DEFAULTHIGHSCOREFILE);
-
     std::vector<Player *> players_;
     std::vector<Ball *> balls_;
     std::vector<Block *> blocks_;
-    std::vector<Joystick *> joysticks_;
+    std::vector<JoystickInput *> joysticks_;
     int remainingSeconds_;
     GameState gameState_;
 //  Aplay soundPlayer_;
-    int currentHighScore;
+    HighScoreStore highScores_;
 };
 
 class BreakoutGame::Player {
 public:
-    Player(CubeApplication *renderCube, int id, Joystick *joystick);
+    Player(CubeApplication *renderCube, int id, JoystickInput *joystick);
 
     void render();
 
@@ -82,7 +81,7 @@ public:
 
     Ball *lastBall();
 
-    Joystick *joystick();
+    JoystickInput *joystick();
 
 private:
     Vector3i centerPosition_;
@@ -99,7 +98,7 @@ private:
     Color blinkColor_;
     Color color_;
     CubeApplication *ca_;
-    Joystick *joystick_;
+    JoystickInput *joystick_;
     Ball *lastBall_;
 };
 
@@ -0,0 +1,124 @@
+#ifndef CUBECOMMON_CUBETOPOLOGY_H
+#define CUBECOMMON_CUBETOPOLOGY_H
+
+#include "CubeApplication.h"
+#include <cstdint>
+#include <utility>
+
+/// Screen and edge classification of virtual cube voxels by table lookup.
+/// Whether a voxel is on a screen or edge only depends on which of its coordinates are 0 or VIRTUALCUBEMAXINDEX.
+/// Each coordinate is mapped to 0 (inside), 1 (at 0) or 2 (at VIRTUALCUBEMAXINDEX) without branching.
+/// The three classes index a 27 entry table that is generated at compile time, so classify() is a single load.
+/// Screens and edges are picked in the same order as the original PixelFlow getScreenNumberThis()/getEdgeNumberThis().
+namespace CubeTopology {
+
+    /// velocity components to exchange when a surface particle warps around an edge
+    enum SwapAxes : uint8_t {
+        noSwap, swapXY, swapYZ, swapXZ
+    };
+
+    struct Cell {
+        uint8_t screen_;
+        uint8_t edge_;
+        uint8_t swap_;
+
+        ScreenNumber screen() const { return (ScreenNumber) screen_; }
+        EdgeNumber edge() const { return (EdgeNumber) edge_; }
+        SwapAxes swap() const { return (SwapAxes) swap_; }
+    };
+
+    struct Table {
+        Cell cells[27];
+    };
+
+    constexpr int axisClass(int v) {
+        return (v == 0) + 2 * (v == VIRTUALCUBEMAXINDEX);
+    }
+
+    constexpr int tableIndex(int x, int y, int z) {
+        return axisClass(x) + 3 * axisClass(y) + 9 * axisClass(z);
+    }
+
+    constexpr ScreenNumber screenOfClasses(int cx, int cy, int cz) {
+        return cx == 1 ? left :
+               cx == 2 ? right :
+               cy == 1 ? front :
+               cy == 2 ? back :
+               cz == 1 ? top :
+               cz == 2 ? bottom : anyScreen;
+    }
+
+    constexpr EdgeNumber edgeOfClasses(int cx, int cy, int cz) {
+        return cx == 2 && cy == 1 ? frontRight :
+               cx == 2 && cy == 2 ? rightBack :
+               cx == 1 && cy == 2 ? backLeft :
+               cx == 1 && cy == 1 ? leftFront :
+               cy == 1 && cz == 1 ? topFront :
+               cx == 2 && cz == 1 ? topRight :
+               cy == 2 && cz == 1 ? topBack :
+               cx == 1 && cz == 1 ? topLeft :
+               cy == 1 && cz == 2 ? bottomFront :
+               cx == 2 && cz == 2 ? bottomRight :
+               cy == 2 && cz == 2 ? bottomBack :
+               cx == 1 && cz == 2 ? bottomLeft : anyEdge;
+    }
+
+    constexpr SwapAxes swapOfClasses(int cx, int cy, int cz) {
+        return cx != 0 && cy != 0 ? swapXY :
+               cy != 0 && cz != 0 ? swapYZ :
+               cx != 0 && cz != 0 ? swapXZ : noSwap;
+    }
+
+    constexpr Table makeTable() {
+        Table table{};
+        for (int i = 0; i < 27; i++) {
+            int cx = i % 3, cy = i / 3 % 3, cz = i / 9;
+            table.cells[i] = Cell{(uint8_t) screenOfClasses(cx, cy, cz), (uint8_t) edgeOfClasses(cx, cy, cz),
+                                  (uint8_t) swapOfClasses(cx, cy, cz)};
+        }
+        return table;
+    }
+
+    constexpr Table table = makeTable();
+
+    static_assert(table.cells[tableIndex(VIRTUALCUBEMAXINDEX, 0, 5)].edge_ == frontRight, "vertical edges win");
+    static_assert(table.cells[tableIndex(5, 0, 0)].edge_ == topFront, "top edges");
+    static_assert(table.cells[tableIndex(0, 5, 5)].screen_ == left, "left/right screens win");
+    static_assert(table.cells[tableIndex(5, 5, 5)].edge_ == anyEdge, "inside the cube");
+
+    inline const Cell &classify(int x, int y, int z) {
+        return table.cells[tableIndex(x, y, z)];
+    }
+
+    inline const Cell &classify(const Vector3i &point) {
+        return classify(point[0], point[1], point[2]);
+    }
+
+    inline ScreenNumber screenNumber(const Vector3i &point) {
+        return classify(point).screen();
+    }
+
+    inline EdgeNumber edgeNumber(const Vector3i &point) {
+        return classify(point).edge();
+    }
+
+    /// exchange the velocity components that move into the next screen
+    inline void applySwap(SwapAxes swap, Vector3f &velocity) {
+        switch (swap) {
+            case swapXY:
+                std::swap(velocity[0], velocity[1]);
+                break;
+            case swapYZ:
+                std::swap(velocity[2], velocity[1]);
+                break;
+            case swapXZ:
+                std::swap(velocity[2], velocity[0]);
+                break;
+            case noSwap:
+            default:
+                break;
+        }
+    }
+}
+
+#endif //CUBECOMMON_CUBETOPOLOGY_H
@@ -0,0 +1,76 @@
+#include "FastRandom.h"
+#include "InputLog.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace FastRandom {
+
+    static uint64_t initialSeed() {
+        uint64_t recorded;
+        if (InputLog::recordedSeed(recorded)) {
+            std::cout << "random seed " << recorded << " from CUBE_INPUT_REPLAY" << std::endl;
+            return recorded;
+        }
+        const char *env = getenv("CUBE_SEED");
+        if (env != nullptr) {
+            uint64_t seed = strtoull(env, nullptr, 0);
+            std::cout << "random seed " << seed << " from CUBE_SEED" << std::endl;
+            return seed;
+        }
+        return (uint64_t) std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
+    static std::atomic<uint64_t> baseSeed(initialSeed());
+    static std::atomic<uint64_t> nextStream(0);
+    static std::atomic<unsigned> seedGeneration(0);
+
+    Generator::Generator(uint64_t seed, uint64_t stream) {
+        this->seed(seed, stream);
+    }
+
+    void Generator::seed(uint64_t seed, uint64_t stream) {
+        //pcg32_srandom
+        state_ = 0;
+        increment_ = (stream << 1u) | 1u;
+        (*this)();
+        state_ += seed;
+        (*this)();
+    }
+
+    Generator &local() {
+        thread_local Generator generator;
+        thread_local unsigned generation = ~0u;
+        if (generation != seedGeneration.load(std::memory_order_acquire)) {
+            generation = seedGeneration.load(std::memory_order_acquire);
+            generator.seed(baseSeed.load(), nextStream++);
+        }
+        return generator;
+    }
+
+    void seed(uint64_t seed) {
+        baseSeed = seed;
+        nextStream = 0;
+        seedGeneration++;
+    }
+
+    uint64_t currentSeed() {
+        return baseSeed.load();
+    }
+
+    struct DirectionTable {
+        Direction entries[360];
+
+        DirectionTable() {
+            for (int i = 0; i < 360; i++)
+                entries[i] = Direction{(float) std::cos(i * M_PI / 180), (float) std::sin(i * M_PI / 180)};
+        }
+    };
+
+    const Direction &direction(int degrees) {
+        static const DirectionTable table;
+        return table.entries[degrees];
+    }
+}
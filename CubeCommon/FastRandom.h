@@ -0,0 +1,69 @@
+#ifndef CUBECOMMON_FASTRANDOM_H
+#define CUBECOMMON_FASTRANDOM_H
+
+#include <cstdint>
+
+/// Lock free random numbers for the hot paths, replaces rand() which takes a lock in glibc.
+/// Every thread owns a PCG32 generator. The generators are derived from one seed, taken from
+/// CUBE_SEED in the environment if set, so runs can be repeated for benchmarking, or from the input log of CUBE_INPUT_REPLAY.
+namespace FastRandom {
+
+    class Generator {
+    public:
+        typedef uint32_t result_type;
+
+        Generator(uint64_t seed = 0, uint64_t stream = 0);
+        void seed(uint64_t seed, uint64_t stream = 0);
+
+        uint32_t operator()() {
+            uint64_t old = state_;
+            state_ = old * 6364136223846793005ull + increment_;
+            uint32_t shifted = (uint32_t) (((old >> 18u) ^ old) >> 27u);
+            uint32_t rot = (uint32_t) (old >> 59u);
+            return (shifted >> rot) | (shifted << ((-rot) & 31u));
+        }
+
+        /// uniform in [0, n) without a division
+        int below(int n) {
+            return (int) (((uint64_t) (*this)() * (uint32_t) n) >> 32);
+        }
+
+        /// uniform in [0, 1)
+        float unit() {
+            return (float) ((*this)() >> 8) * (1.0f / 16777216.0f);
+        }
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return UINT32_MAX; }
+
+    private:
+        uint64_t state_;
+        uint64_t increment_;
+    };
+
+    struct Direction {
+        float x;
+        float y;
+    };
+
+    /// generator of the calling thread
+    Generator &local();
+
+    /// reseed all threads, threads get their own stream in the order they first draw a number
+    void seed(uint64_t seed);
+
+    /// seed of the current generators, stored with recorded input
+    uint64_t currentSeed();
+
+    inline uint32_t next() { return local()(); }
+    inline int below(int n) { return local().below(n); }
+    inline float unit() { return local().unit(); }
+    inline float uniform(float min, float max) { return min + (max - min) * local().unit(); }
+
+    /// cos and sin of degrees, degrees in [0, 360)
+    const Direction &direction(int degrees);
+    /// cos and sin of a random whole degree, what rand()%360 followed by cos()/sin() used to give
+    inline const Direction &randomDirection() { return direction(below(360)); }
+}
+
+#endif //CUBECOMMON_FASTRANDOM_H
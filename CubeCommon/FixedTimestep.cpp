@@ -0,0 +1,66 @@
+#include "FixedTimestep.h"
+#include <cstdlib>
+
+float FixedTimestep::frameClockRate_ = 0;
+
+FixedTimestep::FixedTimestep(float tickRate, int maxTicks) {
+    tickRate_ = tickRate;
+    maxTicks_ = maxTicks;
+    tick_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / tickRate));
+    reset();
+}
+
+void FixedTimestep::reset() {
+    accumulator_ = Clock::duration::zero();
+    started_ = false;
+}
+
+void FixedTimestep::frameClock(float fps) {
+    frameClockRate_ = fps;
+}
+
+int FixedTimestep::advance() {
+    if (frameClockRate_ > 0) {
+        accumulator_ += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameClockRate_));
+    } else {
+        Clock::time_point now = Clock::now();
+        if (!started_) {
+            //the first frame always gets one tick
+            started_ = true;
+            last_ = now;
+            accumulator_ = tick_;
+        }
+        accumulator_ += now - last_;
+        last_ = now;
+    }
+
+    int ticks = (int) (accumulator_ / tick_);
+    if (ticks > maxTicks_) {
+        ticks = maxTicks_;
+        accumulator_ = accumulator_ % tick_ + ticks * tick_;
+    }
+    accumulator_ -= ticks * tick_;
+    return ticks;
+}
+
+float FixedTimestep::alpha() {
+    return (float) accumulator_.count() / (float) tick_.count();
+}
+
+float FixedTimestep::tickRate() {
+    return tickRate_;
+}
+
+float FixedTimestep::tickRateFromEnvironment(float fallback) {
+    const char *env = getenv("CUBE_TICK_RATE");
+    if (env != nullptr && atof(env) > 0)
+        return (float) atof(env);
+    return fallback;
+}
+
+int FixedTimestep::displayRateFromEnvironment(int fallback) {
+    const char *env = getenv("CUBE_FPS");
+    if (env != nullptr && atoi(env) > 0)
+        return atoi(env);
+    return fallback;
+}
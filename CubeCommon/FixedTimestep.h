@@ -0,0 +1,43 @@
+#ifndef CUBECOMMON_FIXEDTIMESTEP_H
+#define CUBECOMMON_FIXEDTIMESTEP_H
+
+#include <chrono>
+
+/// Runs the simulation at a fixed tick rate independent of the display rate.
+/// advance() is called once per loop() and returns how many ticks are due for the wall clock time
+/// since the last call, alpha() is how far the display is between the last tick and the next one,
+/// use it to interpolate positions for rendering.
+class FixedTimestep {
+public:
+    /// at most maxTicks per advance(), a longer stall slows the simulation down instead of freezing the display
+    FixedTimestep(float tickRate, int maxTicks = 8);
+
+    int advance();
+    /// 0 right at the last tick, approaching 1 just before the next one
+    float alpha();
+    float tickRate();
+    void reset();
+
+    /// advance() assumes exactly one frame at fps passed per call instead of reading the clock, 0 goes back to the clock.
+    /// Used by headless runs that loop unthrottled but have to simulate the same as on the cube
+    static void frameClock(float fps);
+
+    /// CUBE_TICK_RATE from the environment, otherwise fallback
+    static float tickRateFromEnvironment(float fallback);
+    /// CUBE_FPS from the environment, otherwise fallback
+    static int displayRateFromEnvironment(int fallback);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    float tickRate_;
+    int maxTicks_;
+    Clock::duration tick_;
+    Clock::duration accumulator_;
+    Clock::time_point last_;
+    bool started_;
+
+    static float frameClockRate_;
+};
+
+#endif //CUBECOMMON_FIXEDTIMESTEP_H
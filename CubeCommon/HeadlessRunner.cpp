@@ -0,0 +1,210 @@
+#include "HeadlessRunner.h"
+#include "CubeApplication.h"
+#include "FixedTimestep.h"
+#include "InputLog.h"
+#include "PhaseTimer.h"
+#include "PngWriter.h"
+#include "SpawnController.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <iostream>
+#include <thread>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<uint8_t> captured;
+    std::vector<Vector3i> surface;
+
+    struct Statistics {
+        double mean;
+        double p50;
+        double p99;
+    };
+
+    void buildSurface() {
+        for (int x = 0; x <= VIRTUALCUBEMAXINDEX; x++) {
+            for (int y = 0; y <= VIRTUALCUBEMAXINDEX; y++) {
+                for (int z = 0; z <= VIRTUALCUBEMAXINDEX; z++) {
+                    if (x == 0 || y == 0 || z == 0 ||
+                        x == VIRTUALCUBEMAXINDEX || y == VIRTUALCUBEMAXINDEX || z == VIRTUALCUBEMAXINDEX)
+                        surface.push_back(Vector3i(x, y, z));
+                }
+            }
+        }
+    }
+
+    /// replaces captured with the current frame
+    void capture(CubeApplication &app) {
+        captured.resize(surface.size() * 3);
+        uint8_t *bytes = captured.data();
+        for (const Vector3i &point : surface) {
+            Color col = app.getPixel3D(point);
+            *bytes++ = col.r();
+            *bytes++ = col.g();
+            *bytes++ = col.b();
+        }
+    }
+
+    double milliseconds(Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    /// nearest rank percentiles, sorts times
+    Statistics statistics(std::vector<double> &times) {
+        if (times.empty())
+            return Statistics{0, 0, 0};
+        std::sort(times.begin(), times.end());
+        double sum = 0;
+        for (double time : times)
+            sum += time;
+        auto percentile = [&times](double p) {
+            size_t rank = (size_t) (p * times.size() + 0.999999);
+            return times[std::min(std::max<size_t>(rank, 1), times.size()) - 1];
+        };
+        return Statistics{sum / times.size(), percentile(0.5), percentile(0.99)};
+    }
+
+    void writeStatistics(std::ostream &out, const char *name, const Statistics &s) {
+        out << "\"" << name << "\": {\"mean\": " << s.mean << ", \"p50\": " << s.p50 << ", \"p99\": " << s.p99 << "}";
+    }
+}
+
+bool HeadlessRunner::runFromEnvironment(MatrixApplication &app) {
+    const char *frames = getenv("CUBE_HEADLESS");
+    if (frames == nullptr)
+        return false;
+    const long frameCount = atol(frames);
+    const bool throttle = getenv("CUBE_HEADLESS_THROTTLE") != nullptr;
+    const char *captureFile = getenv("CUBE_HEADLESS_CAPTURE");
+    const char *jsonFile = getenv("CUBE_HEADLESS_JSON");
+    const char *hashFile = getenv("CUBE_HEADLESS_HASHES");
+    const char *pngPrefix = getenv("CUBE_HEADLESS_PNG");
+    std::set<long> pngFrames;
+    if (getenv("CUBE_HEADLESS_PNG_FRAMES") != nullptr) {
+        std::istringstream list(getenv("CUBE_HEADLESS_PNG_FRAMES"));
+        std::string frame;
+        while (std::getline(list, frame, ','))
+            pngFrames.insert(atol(frame.c_str()));
+    }
+
+    CubeApplication *cube = dynamic_cast<CubeApplication *>(&app);
+    std::ofstream captureOut, hashOut;
+    if (cube != nullptr && captureFile != nullptr)
+        captureOut.open(captureFile, std::ios::binary);
+    if (cube != nullptr && hashFile != nullptr)
+        hashOut.open(hashFile);
+    const bool readBack = captureOut.is_open() || hashOut.is_open();
+    if (readBack && surface.empty())
+        buildSurface();
+    captured.clear();
+    FixedTimestep::frameClock(app.getFps());
+    const char *density = getenv("CUBE_SPAWN_DENSITY");
+    SpawnController::holdDensity(density != nullptr ? (float) atof(density) : 1.0f);
+
+    std::vector<double> loopTimes, renderTimes;
+    loopTimes.reserve(frameCount);
+    renderTimes.reserve(frameCount);
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / app.getFps()));
+    //the apps time render() inside loop(), the frame is sent once
+    const PhaseHistogram &renderPhase = PhaseTimers::phase("render");
+    const Clock::time_point start = Clock::now();
+    for (long currentFrame = 0; currentFrame < frameCount; currentFrame++) {
+        InputFrame::drive(currentFrame);
+        const uint64_t renderCount = renderPhase.count(), renderSum = renderPhase.sum();
+        Clock::time_point loopStart = Clock::now();
+        app.loop();
+        loopTimes.push_back(milliseconds(Clock::now() - loopStart));
+        if (renderPhase.count() > renderCount)
+            renderTimes.push_back((renderPhase.sum() - renderSum) / 1e6);
+        if (readBack) {
+            capture(*cube);
+            if (captureOut.is_open())
+                captureOut.write((const char *) captured.data(), captured.size());
+            if (hashOut.is_open())
+                hashOut << currentFrame << " " << std::hex << std::setw(16) << std::setfill('0') << frameHash()
+                        << std::dec << "\n";
+        }
+        if (cube != nullptr) {
+            if (pngPrefix != nullptr && pngFrames.count(currentFrame) > 0 &&
+                !PngWriter::write(pngPrefix + std::to_string(currentFrame) + ".png", 6 * CUBESIZE, CUBESIZE,
+                                  unfold(*cube)))
+                std::cout << "headless: could not write frame " << currentFrame << " to " << pngPrefix << std::endl;
+        }
+        if (throttle)
+            std::this_thread::sleep_until(start + period * (currentFrame + 1));
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const Statistics loop = statistics(loopTimes);
+    const Statistics render = statistics(renderTimes);
+    std::cout << "headless: " << frameCount << " frames in " << seconds << "s, loop() mean " << loop.mean
+              << "ms p50 " << loop.p50 << "ms p99 " << loop.p99 << "ms, render() mean " << render.mean << "ms"
+              << std::endl;
+
+    if (jsonFile != nullptr) {
+        std::ofstream file(jsonFile);
+        file << "{\"frames\": " << frameCount << ", \"fps\": " << app.getFps() << ", \"seconds\": " << seconds << ", ";
+        writeStatistics(file, "loop_ms", loop);
+        file << ", ";
+        writeStatistics(file, "render_ms", render);
+        file << "}" << std::endl;
+        if (!file)
+            std::cout << "headless: could not write " << jsonFile << std::endl;
+    }
+    hashOut.close();
+    if (hashFile != nullptr && (cube == nullptr || !hashOut))
+        std::cout << "headless: could not write " << hashFile << std::endl;
+    captureOut.close();
+    if (captureFile != nullptr && (cube == nullptr || !captureOut))
+        std::cout << "headless: could not write " << captureFile << std::endl;
+    FixedTimestep::frameClock(0);
+    SpawnController::holdDensity(-1);
+    InputFrame::release();
+    return true;
+}
+
+long HeadlessRunner::frame() {
+    return InputFrame::current();
+}
+
+int HeadlessRunner::surfaceVoxels() {
+    const int side = VIRTUALCUBEMAXINDEX + 1;
+    return side * side * side - (side - 2) * (side - 2) * (side - 2);
+}
+
+const std::vector<uint8_t> &HeadlessRunner::lastFrame() {
+    return captured;
+}
+
+uint64_t HeadlessRunner::frameHash() {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint8_t byte : captured) {
+        hash ^= byte;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::vector<uint8_t> HeadlessRunner::unfold(CubeApplication &app) {
+    const ScreenNumber order[6] = {top, left, front, right, back, bottom};
+    const int width = 6 * CUBESIZE;
+    std::vector<uint8_t> rgb((size_t) width * CUBESIZE * 3);
+    for (int screen = 0; screen < 6; screen++) {
+        for (int y = 0; y < CUBESIZE; y++) {
+            for (int x = 0; x < CUBESIZE; x++) {
+                Color col = app.getPixel3D(app.getPointOnScreen(order[screen], Vector2i(x, y)));
+                uint8_t *pixel = &rgb[((size_t) y * width + screen * CUBESIZE + x) * 3];
+                pixel[0] = col.r();
+                pixel[1] = col.g();
+                pixel[2] = col.b();
+            }
+        }
+    }
+    return rgb;
+}
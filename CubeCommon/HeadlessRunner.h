@@ -0,0 +1,48 @@
+#ifndef CUBECOMMON_HEADLESSRUNNER_H
+#define CUBECOMMON_HEADLESSRUNNER_H
+
+#include "CubeApplication.h"
+#include <cstdint>
+#include <vector>
+
+/// Runs an app without the cube: loop() is called directly for a fixed number of frames instead of start(),
+/// unthrottled by default, with the simulation clock advancing exactly one frame per loop() (FixedTimestep::frameClock()).
+/// With CUBE_HEADLESS_CAPTURE or CUBE_HEADLESS_HASHES the surface voxels of a CubeApplication are read back after
+/// every frame and written out right away, nothing is kept but the last frame, so long runs need no more memory.
+/// The app is still constructed with its matrixapplication server connection and render() still sends the frames,
+/// the connection lives in the library and has no replacement in this tree.
+/// Environment:
+///   CUBE_HEADLESS=<frames>          run headless for that many frames
+///   CUBE_HEADLESS_THROTTLE          keep the app's frame rate instead of running as fast as possible
+///   CUBE_SPAWN_DENSITY=<0..1>       density SpawnController holds, default 1, the most work per frame
+///   CUBE_HEADLESS_CAPTURE=<file>    write the captured frames to file, surfaceVoxels() RGB bytes per frame
+///   CUBE_HEADLESS_HASHES=<file>     write "<frame> <hash>" per frame, FNV-1a 64 of the surface bytes
+///   CUBE_HEADLESS_PNG=<prefix>      write the frames listed in CUBE_HEADLESS_PNG_FRAMES (comma separated) to
+///                                   <prefix><frame>.png, unfolded into the 384x64 layout Picture shows
+///   CUBE_HEADLESS_JSON=<file>       write mean/p50/p99 of the loop() time (render() inside it included)
+///                                   and of the "render" PHASE_TIMER the apps put around render() as JSON
+/// Input comes from CUBE_JOYSTICK_SCRIPT (JoystickInput), CUBE_IMU_REPLAY/CUBE_IMU_CONSTANT (ImuDevice)
+/// or a recorded input log (CUBE_INPUT_REPLAY, InputLog).
+namespace HeadlessRunner {
+
+    /// false if CUBE_HEADLESS is not set, the app should be started on the cube then
+    bool runFromEnvironment(MatrixApplication &app);
+
+    /// number of the frame currently in loop(), counting from 0
+    long frame();
+
+    /// 66^3 - 64^3 voxels on the cube surface
+    int surfaceVoxels();
+
+    /// RGB of the surface voxels of the last captured frame, x, y, z ascending, empty if nothing is captured
+    const std::vector<uint8_t> &lastFrame();
+
+    /// FNV-1a 64 of the last captured frame
+    uint64_t frameHash();
+
+    /// screens top, left, front, right, back, bottom next to each other as getPointOnScreen() maps them,
+    /// 384x64 RGB of the app's current frame
+    std::vector<uint8_t> unfold(CubeApplication &app);
+}
+
+#endif //CUBECOMMON_HEADLESSRUNNER_H
@@ -0,0 +1,117 @@
+#include "HighScoreStore.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <fcntl.h>
+#include <libgen.h>
+#include <unistd.h>
+
+//changes within this time go to the file together
+static const std::chrono::milliseconds batchDelay(1000);
+
+HighScoreStore::HighScoreStore(const std::string &filename, int entries) {
+    filename_ = filename;
+    entries_ = std::max(entries, 1);
+    dirty_ = false;
+    stop_ = false;
+    load();
+    thread_ = std::thread(&HighScoreStore::run, this);
+}
+
+HighScoreStore::~HighScoreStore() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void HighScoreStore::load() {
+    std::ifstream file(filename_);
+    int score;
+    while (file >> score)
+        table_.push_back(score);
+    std::sort(table_.begin(), table_.end(), std::greater<int>());
+    if ((int) table_.size() > entries_)
+        table_.resize(entries_);
+    if (file.is_open())
+        std::cout << "read " << table_.size() << " high scores from " << filename_ << ", highscore: " << best()
+                  << std::endl;
+}
+
+int HighScoreStore::best() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return table_.empty() ? 0 : table_.front();
+}
+
+std::vector<int> HighScoreStore::table() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return table_;
+}
+
+bool HighScoreStore::submit(int score) {
+    bool isBest;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if ((int) table_.size() == entries_ && score <= table_.back())
+            return false;
+        //an empty table counts as a best of 0, like the single stored number before
+        isBest = score > (table_.empty() ? 0 : table_.front());
+        table_.insert(std::upper_bound(table_.begin(), table_.end(), score, std::greater<int>()), score);
+        if ((int) table_.size() > entries_)
+            table_.pop_back();
+        dirty_ = true;
+    }
+    if (isBest)
+        std::cout << "NEW HIGHSCORE: " << score << std::endl;
+    wake_.notify_one();
+    return isBest;
+}
+
+void HighScoreStore::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return dirty_ || stop_; });
+        //a burst of submits ends up in one write
+        wake_.wait_for(lock, batchDelay, [this] { return stop_; });
+        if (dirty_) {
+            std::vector<int> table = table_;
+            dirty_ = false;
+            lock.unlock();
+            if (!write(table))
+                std::cout << "could not write high scores to " << filename_ << std::endl;
+            lock.lock();
+        }
+        if (stop_ && !dirty_)
+            return;
+    }
+}
+
+bool HighScoreStore::write(const std::vector<int> &table) {
+    std::string text;
+    for (int score : table)
+        text += std::to_string(score) + "\n";
+
+    const std::string temporary = filename_ + ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    bool ok = ::write(fd, text.data(), text.size()) == (ssize_t) text.size() && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), filename_.c_str()) != 0) {
+        unlink(temporary.c_str());
+        return false;
+    }
+    //the rename itself is only durable once the directory is synced
+    std::vector<char> path(filename_.begin(), filename_.end());
+    path.push_back('\0');
+    int directory = open(dirname(path.data()), O_RDONLY | O_DIRECTORY);
+    if (directory >= 0) {
+        fsync(directory);
+        close(directory);
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef CUBECOMMON_HIGHSCORESTORE_H
+#define CUBECOMMON_HIGHSCORESTORE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Top-N high score table of a game, cached in memory and persisted by a background thread.
+/// submit() and best() only touch the cache, the loop() thread never waits for the file.
+/// The writer collects the changes of about a second and replaces the file with a temporary one that is
+/// fsynced and renamed, after a crash or power loss the file holds either the old or the new table.
+/// The file has one score per line, highest first, the single number of older versions reads as a table of one.
+class HighScoreStore {
+public:
+    /// reads filename on the calling thread, construct it before the game starts
+    HighScoreStore(const std::string &filename, int entries = 10);
+    /// writes pending changes
+    ~HighScoreStore();
+
+    /// highest score, 0 while the table is empty
+    int best();
+    /// highest first
+    std::vector<int> table();
+    /// enters score into the table, true if it is a new best
+    bool submit(int score);
+
+private:
+    void load();
+    void run();
+    bool write(const std::vector<int> &table);
+
+    std::string filename_;
+    int entries_;
+    std::vector<int> table_;
+    bool dirty_;
+    bool stop_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::thread thread_;
+};
+
+#endif //CUBECOMMON_HIGHSCORESTORE_H
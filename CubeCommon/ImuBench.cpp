@@ -0,0 +1,48 @@
+#include "ImuFilter.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+//runs a recording through the complementary filter as fast as possible
+//and prints the throughput and how much the raw and filtered vectors jump from one reading to the next
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: imubench <recording> [time constant s] [passes]" << std::endl;
+        return 1;
+    }
+    float timeConstant = argc > 2 ? (float) atof(argv[2]) : 0.3f;
+    int passes = argc > 3 ? atoi(argv[3]) : 100;
+    ImuReplayDevice device(argv[1], false, 1000000);
+    if (device.size() == 0)
+        return 1;
+
+    ComplementaryFilter filter(timeConstant);
+    std::vector<ImuReading> readings;
+    Vector3f lastRaw(0, 0, 0), lastFiltered(0, 0, 0);
+    double rawJitter = 0, filteredJitter = 0;
+    long total = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (total < (long) device.size() * passes) {
+        readings.clear();
+        device.read(readings);
+        for (const ImuReading &reading : readings) {
+            filter.update(reading);
+            if (total > 0) {
+                rawJitter += (reading.acceleration - lastRaw).norm();
+                filteredJitter += (filter.gravity() - lastFiltered).norm();
+            }
+            lastRaw = reading.acceleration;
+            lastFiltered = filter.gravity();
+            total++;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "readings " << total << ", " << total / elapsed.count() / 1e6 << " M readings/s" << std::endl;
+    std::cout << "mean change per reading raw " << rawJitter / (total - 1) << " filtered " << filteredJitter / (total - 1)
+              << std::endl;
+    std::cout << "gravity " << filter.gravity().transpose() << " angular rate " << filter.angularRate().transpose()
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include "ImuDevice.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+int64_t ImuDevice::nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::unique_ptr<ImuDevice> ImuDevice::fromEnvironment() {
+    //a replayed input log replaces the sensor, see ImuService
+    if (getenv("CUBE_INPUT_REPLAY") != nullptr)
+        return std::unique_ptr<ImuDevice>(new ConstantImuDevice(Vector3f(0, 0, 0)));
+    const char *constant = getenv("CUBE_IMU_CONSTANT");
+    if (constant != nullptr) {
+        Vector3f acceleration(0, 0, 0);
+        std::istringstream(constant) >> acceleration[0] >> acceleration[1] >> acceleration[2];
+        return std::unique_ptr<ImuDevice>(new ConstantImuDevice(acceleration));
+    }
+    const char *replay = getenv("CUBE_IMU_REPLAY");
+    if (replay != nullptr) {
+        std::unique_ptr<ImuReplayDevice> device(new ImuReplayDevice(replay, getenv("CUBE_HEADLESS") == nullptr));
+        if (device->size() > 0)
+            return device;
+    }
+    const char *type = getenv("CUBE_IMU");
+    if (type != nullptr && std::string(type) == "fifo") {
+        std::unique_ptr<Mpu6050FifoDevice> device(new Mpu6050FifoDevice());
+        const char *axes = getenv("CUBE_IMU_AXES");
+        if (device->isOpen() && (axes == nullptr || device->axes(axes)))
+            return device;
+        std::cout << "MPU6050 FIFO not available, using Mpu6050" << std::endl;
+    }
+    return std::unique_ptr<ImuDevice>(new Mpu6050Device());
+}
+
+Mpu6050Device::Mpu6050Device() {
+    imu_.init();
+}
+
+int Mpu6050Device::read(std::vector<ImuReading> &readings) {
+    readings.push_back(ImuReading{imu_.getAcceleration(), Vector3f(0, 0, 0), nowUs()});
+    return 1;
+}
+
+//MPU6050 registers
+enum : uint8_t {
+    regSampleRateDivider = 0x19, regConfig = 0x1A, regGyroConfig = 0x1B, regAccelConfig = 0x1C,
+    regFifoEnable = 0x23, regUserControl = 0x6A, regPowerManagement1 = 0x6B,
+    regFifoCountHigh = 0x72, regFifoReadWrite = 0x74
+};
+//accelerometer and gyro xyz, big endian int16 each
+static const int fifoRecordSize = 12;
+static const int fifoSize = 1024;
+//full scale +-2 g and +-250 deg/s
+static const float accelerationPerLsb = 1.0f / 16384.0f;
+static const float angularRatePerLsb = (float) (M_PI / 180.0) / 131.0f;
+
+Mpu6050FifoDevice::Mpu6050FifoDevice(int bus, int address, int sampleRateHz) {
+    sampleRateHz_ = sampleRateHz;
+    lastTimestampUs_ = 0;
+    buffer_.resize(fifoSize);
+    axes("+x+y+z");
+    const char *scale = getenv("CUBE_IMU_SCALE");
+    accelerationScale_ = scale != nullptr ? (float) atof(scale) : 9.81f;
+
+    std::string device = "/dev/i2c-" + std::to_string(bus);
+    fd_ = open(device.c_str(), O_RDWR);
+    if (fd_ < 0 || ioctl(fd_, I2C_SLAVE, address) < 0) {
+        std::cout << "can not open MPU6050 on " << device << std::endl;
+        if (fd_ >= 0)
+            close(fd_);
+        fd_ = -1;
+        return;
+    }
+    //gyro x clock, 1 kHz internal rate with the 44 Hz low pass, divided down to the sample rate
+    bool ok = writeRegister(regPowerManagement1, 0x01) &&
+              writeRegister(regConfig, 0x03) &&
+              writeRegister(regSampleRateDivider, (uint8_t) (1000 / sampleRateHz_ - 1)) &&
+              writeRegister(regGyroConfig, 0x00) &&
+              writeRegister(regAccelConfig, 0x00) &&
+              writeRegister(regFifoEnable, 0x78);
+    if (!ok) {
+        std::cout << "MPU6050 setup failed" << std::endl;
+        close(fd_);
+        fd_ = -1;
+        return;
+    }
+    resetFifo();
+}
+
+Mpu6050FifoDevice::~Mpu6050FifoDevice() {
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+bool Mpu6050FifoDevice::isOpen() {
+    return fd_ >= 0;
+}
+
+bool Mpu6050FifoDevice::axes(const std::string &axes) {
+    if (axes.size() != 6) {
+        std::cout << "invalid IMU axes " << axes << std::endl;
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        char sign = axes[2 * i], axis = axes[2 * i + 1];
+        if ((sign != '+' && sign != '-') || axis < 'x' || axis > 'z') {
+            std::cout << "invalid IMU axes " << axes << std::endl;
+            return false;
+        }
+        sign_[i] = sign == '+' ? 1.0f : -1.0f;
+        axis_[i] = axis - 'x';
+    }
+    return true;
+}
+
+bool Mpu6050FifoDevice::writeRegister(uint8_t reg, uint8_t value) {
+    uint8_t data[2] = {reg, value};
+    return write(fd_, data, 2) == 2;
+}
+
+bool Mpu6050FifoDevice::readRegisters(uint8_t reg, uint8_t *data, int length) {
+    return write(fd_, &reg, 1) == 1 && ::read(fd_, data, length) == length;
+}
+
+void Mpu6050FifoDevice::resetFifo() {
+    writeRegister(regUserControl, 0x04);
+    writeRegister(regUserControl, 0x40);
+    lastTimestampUs_ = nowUs();
+}
+
+Vector3f Mpu6050FifoDevice::toCube(const int16_t *raw, float scale) {
+    return Vector3f(sign_[0] * raw[axis_[0]] * scale, sign_[1] * raw[axis_[1]] * scale,
+                    sign_[2] * raw[axis_[2]] * scale);
+}
+
+int Mpu6050FifoDevice::read(std::vector<ImuReading> &readings) {
+    if (fd_ < 0)
+        return 0;
+    uint8_t countBytes[2];
+    if (!readRegisters(regFifoCountHigh, countBytes, 2))
+        return 0;
+    int count = countBytes[0] << 8 | countBytes[1];
+    if (count >= fifoSize) {
+        //overflowed, the records are no longer aligned
+        resetFifo();
+        return 0;
+    }
+    count -= count % fifoRecordSize;
+    if (count == 0 || !readRegisters(regFifoReadWrite, buffer_.data(), count))
+        return 0;
+
+    //the chip has no timestamps, the records are one sample period apart and the newest one is now
+    const int records = count / fifoRecordSize;
+    const int64_t now = nowUs();
+    const int64_t periodUs = 1000000 / sampleRateHz_;
+    for (int r = 0; r < records; r++) {
+        int16_t raw[6];
+        for (int i = 0; i < 6; i++)
+            raw[i] = (int16_t) (buffer_[r * fifoRecordSize + 2 * i] << 8 | buffer_[r * fifoRecordSize + 2 * i + 1]);
+        int64_t timestamp = std::max(lastTimestampUs_ + 1, now - (records - 1 - r) * periodUs);
+        readings.push_back(ImuReading{toCube(raw, accelerationPerLsb * accelerationScale_),
+                                      toCube(raw + 3, angularRatePerLsb), timestamp});
+        lastTimestampUs_ = timestamp;
+    }
+    return records;
+}
+
+ImuReplayDevice::ImuReplayDevice(const std::string &filename, bool realTime, int64_t stepUs) {
+    realTime_ = realTime;
+    stepUs_ = stepUs;
+    position_ = 0;
+    started_ = false;
+    offsetUs_ = 0;
+    replayUs_ = 0;
+
+    std::ifstream file(filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        ImuReading reading;
+        fields >> reading.timestampUs >> reading.acceleration[0] >> reading.acceleration[1] >> reading.acceleration[2]
+               >> reading.angularRate[0] >> reading.angularRate[1] >> reading.angularRate[2];
+        if (fields)
+            recording_.push_back(reading);
+    }
+    std::cout << "replaying " << recording_.size() << " IMU readings from " << filename << std::endl;
+}
+
+int ImuReplayDevice::size() {
+    return (int) recording_.size();
+}
+
+int ImuReplayDevice::read(std::vector<ImuReading> &readings) {
+    if (recording_.empty())
+        return 0;
+    if (!started_) {
+        //recordings may start at timestamp 0
+        started_ = true;
+        replayUs_ = realTime_ ? nowUs() : recording_.front().timestampUs;
+        offsetUs_ = replayUs_ - recording_.front().timestampUs;
+    }
+    //real time follows the clock, otherwise every read advances the replay clock by one step
+    replayUs_ = realTime_ ? nowUs() : replayUs_ + stepUs_;
+    //capped so a recording with broken timestamps can not stall the caller
+    int count = 0;
+    while (count < 4096 && recording_[position_].timestampUs + offsetUs_ <= replayUs_) {
+        ImuReading reading = recording_[position_];
+        reading.timestampUs += offsetUs_;
+        readings.push_back(reading);
+        count++;
+        if (++position_ == recording_.size()) {
+            //continue one average sample period after the last reading
+            int64_t duration = recording_.back().timestampUs - recording_.front().timestampUs;
+            int64_t period = recording_.size() > 1 ? duration / (int64_t) (recording_.size() - 1) : 0;
+            offsetUs_ += duration + std::max<int64_t>(period, 1000);
+            position_ = 0;
+        }
+    }
+    return count;
+}
+
+ConstantImuDevice::ConstantImuDevice(const Vector3f &acceleration) {
+    acceleration_ = acceleration;
+    timestampUs_ = 0;
+}
+
+int ConstantImuDevice::read(std::vector<ImuReading> &readings) {
+    timestampUs_ += 5000;
+    readings.push_back(ImuReading{acceleration_, Vector3f(0, 0, 0), timestampUs_});
+    return 1;
+}
+
+ImuRecorder::ImuRecorder(const std::string &filename) : file_(filename) {
+    file_ << "# timestampUs ax ay az gx gy gz" << std::endl;
+}
+
+void ImuRecorder::write(const ImuReading &reading) {
+    file_ << reading.timestampUs << " " << reading.acceleration[0] << " " << reading.acceleration[1] << " "
+          << reading.acceleration[2] << " " << reading.angularRate[0] << " " << reading.angularRate[1] << " "
+          << reading.angularRate[2] << "\n";
+}
@@ -0,0 +1,132 @@
+#ifndef CUBECOMMON_IMUDEVICE_H
+#define CUBECOMMON_IMUDEVICE_H
+
+#include "CubeApplication.h"
+#include <Mpu6050.h>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// One accelerometer and gyro reading in cube coordinates.
+struct ImuReading {
+    Vector3f acceleration;
+    /// rad/s, zero for devices without a gyro
+    Vector3f angularRate;
+    /// steady clock microseconds
+    int64_t timestampUs;
+};
+
+/// Source of IMU readings for ImuService.
+class ImuDevice {
+public:
+    virtual ~ImuDevice() = default;
+
+    /// append the readings that arrived since the last call, returns how many
+    virtual int read(std::vector<ImuReading> &readings) = 0;
+    virtual bool hasGyro() = 0;
+    /// false for devices that only advance when read, ImuService reads those on the caller's thread for repeatable runs
+    virtual bool isLive() { return true; }
+
+    /// CUBE_IMU_CONSTANT="x y z" holds one acceleration, CUBE_IMU_REPLAY=<file> replays a recording
+    /// (one frame of it per read under CUBE_HEADLESS), CUBE_IMU=fifo reads the MPU6050 FIFO directly,
+    /// everything else uses the Mpu6050 class of matrixapplication
+    static std::unique_ptr<ImuDevice> fromEnvironment();
+    static int64_t nowUs();
+};
+
+/// The Mpu6050 of matrixapplication, one accelerometer reading per call.
+class Mpu6050Device : public ImuDevice {
+public:
+    Mpu6050Device();
+
+    int read(std::vector<ImuReading> &readings) override;
+    bool hasGyro() override { return false; }
+
+    Mpu6050 &imu() { return imu_; }
+
+private:
+    Mpu6050 imu_;
+};
+
+/// MPU6050 on /dev/i2c-<bus> with accelerometer and gyro samples collected in its FIFO.
+/// read() fetches everything the chip buffered in one burst instead of one I2C transaction per value.
+/// Sensor axes are mapped to cube axes by an axes string like "+x-z+y" (CUBE_IMU_AXES), the first
+/// entry is the sensor axis that becomes cube x. Acceleration is scaled to the same unit as the Mpu6050 class
+/// (CUBE_IMU_SCALE per g, default 9.81).
+class Mpu6050FifoDevice : public ImuDevice {
+public:
+    Mpu6050FifoDevice(int bus = 1, int address = 0x68, int sampleRateHz = 200);
+    ~Mpu6050FifoDevice() override;
+
+    bool isOpen();
+    bool axes(const std::string &axes);
+
+    int read(std::vector<ImuReading> &readings) override;
+    bool hasGyro() override { return true; }
+
+private:
+    bool writeRegister(uint8_t reg, uint8_t value);
+    bool readRegisters(uint8_t reg, uint8_t *data, int length);
+    void resetFifo();
+    Vector3f toCube(const int16_t *raw, float scale);
+
+    int fd_;
+    int sampleRateHz_;
+    int axis_[3];
+    float sign_[3];
+    float accelerationScale_;
+    int64_t lastTimestampUs_;
+    std::vector<uint8_t> buffer_;
+};
+
+/// Plays back a recording made with ImuRecorder, loops at the end of the file.
+/// In real time the readings are handed out when their timestamp is due, otherwise every read() returns the next
+/// stepUs of the recording at once, which is what benchmarks and headless runs want.
+class ImuReplayDevice : public ImuDevice {
+public:
+    ImuReplayDevice(const std::string &filename, bool realTime = true, int64_t stepUs = 25000);
+
+    int read(std::vector<ImuReading> &readings) override;
+    bool hasGyro() override { return true; }
+    bool isLive() override { return realTime_; }
+
+    int size();
+
+private:
+    std::vector<ImuReading> recording_;
+    bool realTime_;
+    int64_t stepUs_;
+    size_t position_;
+    bool started_;
+    int64_t offsetUs_;
+    int64_t replayUs_;
+};
+
+/// Always reports the same acceleration, for scripted runs.
+class ConstantImuDevice : public ImuDevice {
+public:
+    ConstantImuDevice(const Vector3f &acceleration);
+
+    int read(std::vector<ImuReading> &readings) override;
+    bool hasGyro() override { return false; }
+    bool isLive() override { return false; }
+
+private:
+    Vector3f acceleration_;
+    int64_t timestampUs_;
+};
+
+/// Writes readings in the text format ImuReplayDevice reads, one reading per line.
+class ImuRecorder {
+public:
+    ImuRecorder(const std::string &filename);
+
+    void write(const ImuReading &reading);
+
+private:
+    std::ofstream file_;
+};
+
+#endif //CUBECOMMON_IMUDEVICE_H
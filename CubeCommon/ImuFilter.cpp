@@ -0,0 +1,48 @@
+#include "ImuFilter.h"
+#include <algorithm>
+
+ComplementaryFilter::ComplementaryFilter(float timeConstant) {
+    timeConstant_ = timeConstant;
+    reset();
+}
+
+void ComplementaryFilter::reset() {
+    gravity_ = Vector3f(0, 0, 0);
+    angularRate_ = Vector3f(0, 0, 0);
+    timestampUs_ = 0;
+    hasEstimate_ = false;
+}
+
+void ComplementaryFilter::update(const ImuReading &reading) {
+    angularRate_ = reading.angularRate;
+    if (!hasEstimate_) {
+        gravity_ = reading.acceleration;
+        timestampUs_ = reading.timestampUs;
+        hasEstimate_ = true;
+        return;
+    }
+    //long gaps are not integrated, the accelerometer takes over
+    float dt = std::min(0.1f, std::max(0.0f, (float) (reading.timestampUs - timestampUs_) * 1e-6f));
+    timestampUs_ = reading.timestampUs;
+
+    //a direction fixed in the room turns against the body rotation
+    Vector3f predicted = gravity_ - reading.angularRate.cross(gravity_) * dt;
+    float alpha = timeConstant_ / (timeConstant_ + dt);
+    gravity_ = alpha * predicted + (1.0f - alpha) * reading.acceleration;
+}
+
+Vector3f ComplementaryFilter::gravity() {
+    return gravity_;
+}
+
+Vector3f ComplementaryFilter::angularRate() {
+    return angularRate_;
+}
+
+int64_t ComplementaryFilter::timestampUs() {
+    return timestampUs_;
+}
+
+bool ComplementaryFilter::hasEstimate() {
+    return hasEstimate_;
+}
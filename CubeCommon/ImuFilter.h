@@ -0,0 +1,32 @@
+#ifndef CUBECOMMON_IMUFILTER_H
+#define CUBECOMMON_IMUFILTER_H
+
+#include "ImuDevice.h"
+
+/// Complementary filter for the gravity vector.
+/// The previous estimate is rotated with the gyro rate and blended with the accelerometer, the gyro follows fast
+/// turns and the accelerometer keeps the long term direction. Without a gyro it is a first order low pass.
+class ComplementaryFilter {
+public:
+    /// timeConstant in seconds, shorter follows the accelerometer closer and lets more noise through
+    ComplementaryFilter(float timeConstant = 0.3f);
+
+    void update(const ImuReading &reading);
+    void reset();
+
+    /// smoothed acceleration in the unit of the device, pointing away from the ground
+    Vector3f gravity();
+    /// rad/s of the newest reading
+    Vector3f angularRate();
+    int64_t timestampUs();
+    bool hasEstimate();
+
+private:
+    float timeConstant_;
+    Vector3f gravity_;
+    Vector3f angularRate_;
+    int64_t timestampUs_;
+    bool hasEstimate_;
+};
+
+#endif //CUBECOMMON_IMUFILTER_H
@@ -0,0 +1,110 @@
+#include "ImuService.h"
+#include "InputLog.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+ImuService::ImuService(std::unique_ptr<ImuDevice> device, int rateHz)
+        : device_(std::move(device)), filter_(device_->hasGyro() ? 0.3f : 0.05f) {
+    rateHz_ = rateHz;
+    sequence_ = 0;
+    count_ = 0;
+    timestampUs_ = 0;
+    for (int i = 0; i < 3; i++) {
+        acceleration_[i] = 0.0f;
+        angularRate_[i] = 0.0f;
+        intersect_[i] = VIRTUALCUBECENTER;
+    }
+    const char *record = getenv("CUBE_IMU_RECORD");
+    if (record != nullptr)
+        recorder_.reset(new ImuRecorder(record));
+    if (InputRecorder::instance() != nullptr)
+        inputRecorder_.reset(new ImuSampleRecorder(InputRecorder::instance()));
+    if (InputLog::instance() != nullptr)
+        inputReplay_.reset(new ImuSampleReplay(InputLog::instance()));
+    readingCount_ = 0;
+    //a replayed input log replaces the device
+    running_ = device_->isLive() && !inputReplay_;
+    if (running_)
+        thread_ = std::thread(&ImuService::run, this);
+}
+
+ImuService::~ImuService() {
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+}
+
+ImuService::Sample ImuService::latest() {
+    if (inputReplay_)
+        return inputReplay_->next();
+    if (!thread_.joinable())
+        poll();
+    Sample sample;
+    uint32_t before, after;
+    do {
+        before = sequence_.load(std::memory_order_acquire);
+        for (int i = 0; i < 3; i++) {
+            sample.acceleration[i] = acceleration_[i].load(std::memory_order_relaxed);
+            sample.angularRate[i] = angularRate_[i].load(std::memory_order_relaxed);
+            sample.cubeAccIntersect[i] = intersect_[i].load(std::memory_order_relaxed);
+        }
+        sample.timestampUs = timestampUs_.load(std::memory_order_relaxed);
+        sample.count = count_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence_.load(std::memory_order_relaxed);
+    } while ((before & 1u) || before != after);
+    if (inputRecorder_)
+        inputRecorder_->write(sample);
+    return sample;
+}
+
+Vector3i ImuService::cubeIntersect(const Vector3f &direction) {
+    const float half = VIRTUALCUBEMAXINDEX / 2.0f;
+    float longest = direction.cwiseAbs().maxCoeff();
+    if (longest < 1e-6f)
+        return Vector3i(VIRTUALCUBECENTER, VIRTUALCUBECENTER, VIRTUALCUBECENTER);
+    Vector3i point;
+    for (int i = 0; i < 3; i++)
+        point[i] = std::min(VIRTUALCUBEMAXINDEX, std::max(0, (int) std::lround(half + direction[i] / longest * half)));
+    return point;
+}
+
+void ImuService::publish(const Sample &sample) {
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < 3; i++) {
+        acceleration_[i].store(sample.acceleration[i], std::memory_order_relaxed);
+        angularRate_[i].store(sample.angularRate[i], std::memory_order_relaxed);
+        intersect_[i].store(sample.cubeAccIntersect[i], std::memory_order_relaxed);
+    }
+    timestampUs_.store(sample.timestampUs, std::memory_order_relaxed);
+    count_.store(sample.count, std::memory_order_relaxed);
+    sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+void ImuService::poll() {
+    readings_.clear();
+    if (device_->read(readings_) == 0)
+        return;
+    for (const ImuReading &reading : readings_) {
+        filter_.update(reading);
+        if (recorder_)
+            recorder_->write(reading);
+    }
+    readingCount_ += (uint32_t) readings_.size();
+    publish(Sample{filter_.gravity(), filter_.angularRate(), cubeIntersect(filter_.gravity()),
+                   filter_.timestampUs(), readingCount_});
+}
+
+void ImuService::run() {
+    const auto period = std::chrono::microseconds(1000000 / rateHz_);
+    auto next = std::chrono::steady_clock::now();
+    while (running_) {
+        poll();
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+}
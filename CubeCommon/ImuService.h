@@ -0,0 +1,69 @@
+#ifndef CUBECOMMON_IMUSERVICE_H
+#define CUBECOMMON_IMUSERVICE_H
+
+#include "CubeApplication.h"
+#include "ImuDevice.h"
+#include "ImuFilter.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class ImuSampleRecorder;
+class ImuSampleReplay;
+
+/// Polls an ImuDevice on its own thread at a fixed rate, runs every reading through a ComplementaryFilter
+/// and publishes the newest estimate. Readers get a consistent snapshot through a sequence lock,
+/// that costs a few loads and never blocks or touches the sensor.
+/// Devices that are not live are read by latest() on the caller's thread instead, so a replay advances once per frame.
+/// CUBE_IMU_RECORD=<file> writes the raw readings for ImuReplayDevice.
+/// With CUBE_INPUT_RECORD the samples latest() returns are logged, with CUBE_INPUT_REPLAY latest() returns the logged ones.
+class ImuService {
+public:
+    struct Sample {
+        /// filtered acceleration, pointing away from the ground
+        Vector3f acceleration;
+        /// rad/s, zero if the device has no gyro
+        Vector3f angularRate;
+        /// where the filtered acceleration leaves the cube, seen from its center
+        Vector3i cubeAccIntersect;
+        /// steady clock microseconds of the newest reading
+        int64_t timestampUs;
+        /// number of readings so far, 0 before the first one
+        uint32_t count;
+    };
+
+    ImuService(std::unique_ptr<ImuDevice> device = ImuDevice::fromEnvironment(), int rateHz = 200);
+    ~ImuService();
+
+    Sample latest();
+
+    static Vector3i cubeIntersect(const Vector3f &direction);
+
+private:
+    void run();
+    /// read the device, filter and publish
+    void poll();
+    void publish(const Sample &sample);
+
+    std::unique_ptr<ImuDevice> device_;
+    ComplementaryFilter filter_;
+    std::unique_ptr<ImuRecorder> recorder_;
+    std::unique_ptr<ImuSampleRecorder> inputRecorder_;
+    std::unique_ptr<ImuSampleReplay> inputReplay_;
+    int rateHz_;
+    std::vector<ImuReading> readings_;
+    uint32_t readingCount_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+
+    //odd while the sampler is writing
+    std::atomic<uint32_t> sequence_;
+    std::atomic<float> acceleration_[3];
+    std::atomic<float> angularRate_[3];
+    std::atomic<int> intersect_[3];
+    std::atomic<int64_t> timestampUs_;
+    std::atomic<uint32_t> count_;
+};
+
+#endif //CUBECOMMON_IMUSERVICE_H
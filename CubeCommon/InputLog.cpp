@@ -0,0 +1,238 @@
+#include "InputLog.h"
+#include "FastRandom.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const char magic[8] = {'C', 'U', 'B', 'E', 'I', 'N', 'P', '1'};
+
+    template<typename T>
+    bool get(std::istream &in, T &value) {
+        return (bool) in.read((char *) &value, sizeof(T));
+    }
+}
+
+std::atomic<long> InputFrame::frame_(-1);
+std::atomic<bool> InputFrame::driven_(false);
+
+long InputFrame::current() {
+    return frame_.load(std::memory_order_relaxed);
+}
+
+void InputFrame::beginFrame() {
+    if (!driven_)
+        frame_++;
+}
+
+void InputFrame::drive(long frame) {
+    driven_ = true;
+    frame_ = frame;
+}
+
+void InputFrame::release() {
+    driven_ = false;
+}
+
+InputRecorder *InputRecorder::instance() {
+    static std::unique_ptr<InputRecorder> recorder(
+            getenv("CUBE_INPUT_RECORD") != nullptr ? new InputRecorder(getenv("CUBE_INPUT_RECORD")) : nullptr);
+    return recorder.get();
+}
+
+InputRecorder::InputRecorder(const std::string &filename) : file_(filename, std::ios::binary) {
+    sources_ = 0;
+    flushedFrame_ = 0;
+    file_.write(magic, sizeof(magic));
+    put<uint64_t>(FastRandom::currentSeed());
+    if (!file_)
+        std::cout << "could not record input to " << filename << std::endl;
+    else
+        std::cout << "recording input to " << filename << std::endl;
+}
+
+InputRecorder::~InputRecorder() {
+    file_.flush();
+}
+
+int InputRecorder::joystickSource() {
+    return sources_++;
+}
+
+void InputRecorder::write(const InputEvent &event) {
+    put<uint8_t>(event.type);
+    put<int32_t>(event.frame);
+    put<uint32_t>(event.call);
+    switch (event.type) {
+        case InputEvent::joystickState:
+            put<uint8_t>(event.source);
+            put<uint8_t>(event.found);
+            put<uint32_t>(event.buttons);
+            put<uint8_t>((uint8_t) event.axes.size());
+            for (float axis : event.axes)
+                put<float>(axis);
+            break;
+        case InputEvent::joystickPress:
+            put<uint8_t>(event.source);
+            put<uint8_t>(event.button);
+            break;
+        case InputEvent::imuSample:
+            for (int i = 0; i < 3; i++)
+                put<float>(event.sample.acceleration[i]);
+            for (int i = 0; i < 3; i++)
+                put<float>(event.sample.angularRate[i]);
+            for (int i = 0; i < 3; i++)
+                put<int16_t>((int16_t) event.sample.cubeAccIntersect[i]);
+            put<int64_t>(event.sample.timestampUs);
+            put<uint32_t>(event.sample.count);
+            break;
+    }
+    //about once a second, a killed app loses at most that much
+    if (event.frame >= flushedFrame_ + 40) {
+        flushedFrame_ = event.frame;
+        file_.flush();
+    }
+}
+
+InputLog *InputLog::instance() {
+    static std::unique_ptr<InputLog> log;
+    static bool opened = false;
+    if (!opened) {
+        opened = true;
+        const char *replay = getenv("CUBE_INPUT_REPLAY");
+        if (replay != nullptr) {
+            log.reset(new InputLog(replay));
+            if (!log->isValid()) {
+                std::cout << "no input log in " << replay << std::endl;
+                log.reset();
+            }
+        }
+    }
+    return log.get();
+}
+
+bool InputLog::recordedSeed(uint64_t &seed) {
+    const char *replay = getenv("CUBE_INPUT_REPLAY");
+    if (replay == nullptr)
+        return false;
+    std::ifstream file(replay, std::ios::binary);
+    char header[sizeof(magic)];
+    return file.read(header, sizeof(header)) && memcmp(header, magic, sizeof(magic)) == 0 && get(file, seed);
+}
+
+InputLog::InputLog(const std::string &filename) {
+    sources_ = 0;
+    seed_ = 0;
+    std::ifstream file(filename, std::ios::binary);
+    char header[sizeof(magic)];
+    valid_ = file.read(header, sizeof(header)) && memcmp(header, magic, sizeof(magic)) == 0 && get(file, seed_);
+    if (!valid_)
+        return;
+
+    uint8_t type;
+    while (get(file, type)) {
+        InputEvent event = InputEvent();
+        event.type = (InputEvent::Type) type;
+        get(file, event.frame);
+        get(file, event.call);
+        bool complete = true;
+        switch (event.type) {
+            case InputEvent::joystickState: {
+                uint8_t found, axes;
+                get(file, event.source);
+                get(file, found);
+                get(file, event.buttons);
+                get(file, axes);
+                event.found = found != 0;
+                event.axes.resize(axes);
+                for (float &axis : event.axes)
+                    get(file, axis);
+                break;
+            }
+            case InputEvent::joystickPress:
+                get(file, event.source);
+                get(file, event.button);
+                break;
+            case InputEvent::imuSample: {
+                int16_t intersect;
+                for (int i = 0; i < 3; i++)
+                    get(file, event.sample.acceleration[i]);
+                for (int i = 0; i < 3; i++)
+                    get(file, event.sample.angularRate[i]);
+                for (int i = 0; i < 3; i++) {
+                    get(file, intersect);
+                    event.sample.cubeAccIntersect[i] = intersect;
+                }
+                get(file, event.sample.timestampUs);
+                get(file, event.sample.count);
+                break;
+            }
+            default:
+                complete = false;
+                break;
+        }
+        //a log cut off by a crash ends with a partial event
+        if (!complete || !file)
+            break;
+        events_.push_back(event);
+    }
+    std::cout << "replaying " << events_.size() << " input events from " << filename << ", seed " << seed_ << std::endl;
+}
+
+bool InputLog::isValid() {
+    return valid_;
+}
+
+uint64_t InputLog::seed() {
+    return seed_;
+}
+
+int InputLog::joystickSource() {
+    return sources_++;
+}
+
+std::vector<InputEvent> InputLog::events(int source) {
+    std::vector<InputEvent> selected;
+    for (const InputEvent &event : events_) {
+        bool imu = event.type == InputEvent::imuSample;
+        if (source < 0 ? imu : !imu && event.source == source)
+            selected.push_back(event);
+    }
+    return selected;
+}
+
+ImuSampleRecorder::ImuSampleRecorder(InputRecorder *recorder) {
+    recorder_ = recorder;
+    lastCount_ = 0;
+}
+
+void ImuSampleRecorder::write(const ImuService::Sample &sample) {
+    long frame;
+    uint32_t call;
+    counter_.next(frame, call);
+    if (sample.count == lastCount_)
+        return;
+    lastCount_ = sample.count;
+    InputEvent event = InputEvent();
+    event.type = InputEvent::imuSample;
+    event.frame = (int32_t) frame;
+    event.call = call;
+    event.sample = sample;
+    recorder_->write(event);
+}
+
+ImuSampleReplay::ImuSampleReplay(InputLog *log) {
+    events_ = log->events(-1);
+    next_ = 0;
+    sample_ = ImuService::Sample{Vector3f(0, 0, 0), Vector3f(0, 0, 0),
+                                 Vector3i(VIRTUALCUBECENTER, VIRTUALCUBECENTER, VIRTUALCUBECENTER), 0, 0};
+}
+
+ImuService::Sample ImuSampleReplay::next() {
+    long frame;
+    uint32_t call;
+    counter_.next(frame, call);
+    while (next_ < events_.size() && events_[next_].before(frame, call))
+        sample_ = events_[next_++].sample;
+    return sample_;
+}
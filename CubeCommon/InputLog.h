@@ -0,0 +1,147 @@
+#ifndef CUBECOMMON_INPUTLOG_H
+#define CUBECOMMON_INPUTLOG_H
+
+#include "ImuService.h"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Number of the frame input is stamped with. Apps call beginFrame() at the start of loop(),
+/// while HeadlessRunner drives the frame number those calls are ignored.
+class InputFrame {
+public:
+    static long current();
+    static void beginFrame();
+    static void drive(long frame);
+    static void release();
+
+private:
+    static std::atomic<long> frame_;
+    static std::atomic<bool> driven_;
+};
+
+/// Counts the calls of an input source within a frame. Input is logged by (frame, call),
+/// so a replay returns exactly what the same call returned while recording.
+class InputCallCounter {
+public:
+    InputCallCounter() : frame_(-2), call_(0) {}
+
+    /// frame and call index of the next call
+    void next(long &frame, uint32_t &call) {
+        frame = InputFrame::current();
+        if (frame != frame_) {
+            frame_ = frame;
+            call_ = 0;
+        }
+        call = call_++;
+    }
+
+private:
+    long frame_;
+    uint32_t call_;
+};
+
+/// One entry of an input log. source is the creation index of the joystick, unused for IMU samples.
+struct InputEvent {
+    enum Type : uint8_t {
+        joystickState = 'J', joystickPress = 'P', imuSample = 'I'
+    };
+
+    Type type;
+    int32_t frame;
+    uint32_t call;
+    uint8_t source;
+    //joystickState
+    bool found;
+    uint32_t buttons;
+    std::vector<float> axes;
+    //joystickPress
+    uint8_t button;
+    //imuSample, zeroed so copies of joystick events do not read uninitialized vectors
+    ImuService::Sample sample = {Vector3f::Zero(), Vector3f::Zero(), Vector3i::Zero(), 0, 0};
+
+    bool before(long frame, uint32_t call) const {
+        return this->frame < frame || (this->frame == frame && this->call <= call);
+    }
+};
+
+/// Writes everything the app got from its joysticks and the IMU to CUBE_INPUT_RECORD, together with the random seed.
+/// Joystick state is logged when it changes, presses when getButtonPress() returned true, IMU samples when latest()
+/// returned a new one. Binary, native byte order: "CUBEINP1", the 64 bit seed, then the events.
+/// Only for the loop() thread.
+class InputRecorder {
+public:
+    /// nullptr if CUBE_INPUT_RECORD is not set
+    static InputRecorder *instance();
+
+    InputRecorder(const std::string &filename);
+    ~InputRecorder();
+
+    /// id of a new joystick
+    int joystickSource();
+    void write(const InputEvent &event);
+
+private:
+    template<typename T>
+    void put(const T &value) { file_.write((const char *) &value, sizeof(T)); }
+
+    std::ofstream file_;
+    int sources_;
+    long flushedFrame_;
+};
+
+/// A log written by InputRecorder, read from CUBE_INPUT_REPLAY. Run it headless (CUBE_HEADLESS) to get the same frames.
+class InputLog {
+public:
+    /// nullptr if CUBE_INPUT_REPLAY is not set or can not be read
+    static InputLog *instance();
+    /// seed stored in the log of CUBE_INPUT_REPLAY, false if there is none
+    static bool recordedSeed(uint64_t &seed);
+
+    InputLog(const std::string &filename);
+
+    bool isValid();
+    uint64_t seed();
+    /// id of a new replayed joystick, in the same creation order as recorded
+    int joystickSource();
+    /// events of a source in log order, joystick sources get only joystick events, source -1 only IMU samples
+    std::vector<InputEvent> events(int source);
+
+private:
+    bool valid_;
+    uint64_t seed_;
+    int sources_;
+    std::vector<InputEvent> events_;
+};
+
+/// Logs the samples ImuService::latest() returns.
+class ImuSampleRecorder {
+public:
+    ImuSampleRecorder(InputRecorder *recorder);
+
+    void write(const ImuService::Sample &sample);
+
+private:
+    InputRecorder *recorder_;
+    InputCallCounter counter_;
+    uint32_t lastCount_;
+};
+
+/// Returns what ImuService::latest() returned while recording, call by call.
+class ImuSampleReplay {
+public:
+    ImuSampleReplay(InputLog *log);
+
+    ImuService::Sample next();
+
+private:
+    std::vector<InputEvent> events_;
+    size_t next_;
+    InputCallCounter counter_;
+    ImuService::Sample sample_;
+};
+
+#endif //CUBECOMMON_INPUTLOG_H
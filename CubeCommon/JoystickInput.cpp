@@ -0,0 +1,193 @@
+#include "JoystickInput.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+JoystickInput *JoystickInput::create(int number) {
+    InputLog *log = InputLog::instance();
+    if (log != nullptr)
+        return new ReplayJoystick(log);
+    const char *script = getenv("CUBE_JOYSTICK_SCRIPT");
+    JoystickInput *joystick;
+    if (script != nullptr)
+        joystick = new ScriptedJoystick(number, script);
+    else
+        joystick = new LiveJoystick(number);
+    InputRecorder *recorder = InputRecorder::instance();
+    if (recorder != nullptr)
+        return new RecordingJoystick(joystick, recorder);
+    return joystick;
+}
+
+LiveJoystick::LiveJoystick(int number) : joystick_(number) {
+}
+
+ScriptedJoystick::ScriptedJoystick(int number, const std::string &filename) {
+    std::ifstream file(filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        State state;
+        int joystick;
+        fields >> state.frame >> joystick >> std::hex >> state.buttons >> std::dec;
+        if (!fields || joystick != number)
+            continue;
+        float axis;
+        while (fields >> axis)
+            state.axes.push_back(axis);
+        script_.push_back(state);
+    }
+    next_ = 0;
+    current_ = State{-1, 0, {}};
+    presses_ = 0;
+}
+
+void ScriptedJoystick::update() {
+    const long frame = InputFrame::current();
+    while (next_ < script_.size() && script_[next_].frame <= frame) {
+        presses_ |= script_[next_].buttons & ~current_.buttons;
+        current_ = script_[next_];
+        next_++;
+    }
+}
+
+float ScriptedJoystick::getAxis(int n) {
+    update();
+    return n < (int) current_.axes.size() ? current_.axes[n] : 0.0f;
+}
+
+bool ScriptedJoystick::getButton(int n) {
+    update();
+    return (current_.buttons >> n) & 1u;
+}
+
+bool ScriptedJoystick::getButtonPress(int n) {
+    update();
+    bool pressed = (presses_ >> n) & 1u;
+    presses_ &= ~(1u << n);
+    return pressed;
+}
+
+void ScriptedJoystick::clearAllButtonPresses() {
+    update();
+    presses_ = 0;
+}
+
+bool ScriptedJoystick::isFound() {
+    return !script_.empty();
+}
+
+RecordingJoystick::RecordingJoystick(JoystickInput *joystick, InputRecorder *recorder) {
+    joystick_ = joystick;
+    recorder_ = recorder;
+    state_ = InputEvent();
+    state_.type = InputEvent::joystickState;
+    state_.source = (uint8_t) recorder->joystickSource();
+    logged_ = state_;
+}
+
+void RecordingJoystick::stamp() {
+    long frame;
+    counter_.next(frame, state_.call);
+    state_.frame = (int32_t) frame;
+}
+
+void RecordingJoystick::logState() {
+    if (state_.found != logged_.found || state_.buttons != logged_.buttons || state_.axes != logged_.axes) {
+        recorder_->write(state_);
+        logged_ = state_;
+    }
+}
+
+float RecordingJoystick::getAxis(int n) {
+    stamp();
+    float value = joystick_->getAxis(n);
+    if (n >= 0 && n < 16) {
+        if ((int) state_.axes.size() <= n)
+            state_.axes.resize(n + 1, 0.0f);
+        state_.axes[n] = value;
+        logState();
+    }
+    return value;
+}
+
+bool RecordingJoystick::getButton(int n) {
+    stamp();
+    bool pressed = joystick_->getButton(n);
+    if (n >= 0 && n < 32) {
+        state_.buttons = pressed ? state_.buttons | (1u << n) : state_.buttons & ~(1u << n);
+        logState();
+    }
+    return pressed;
+}
+
+bool RecordingJoystick::getButtonPress(int n) {
+    stamp();
+    bool pressed = joystick_->getButtonPress(n);
+    if (pressed) {
+        InputEvent press = state_;
+        press.type = InputEvent::joystickPress;
+        press.button = (uint8_t) n;
+        recorder_->write(press);
+    }
+    return pressed;
+}
+
+void RecordingJoystick::clearAllButtonPresses() {
+    stamp();
+    joystick_->clearAllButtonPresses();
+}
+
+bool RecordingJoystick::isFound() {
+    stamp();
+    state_.found = joystick_->isFound();
+    logState();
+    return state_.found;
+}
+
+ReplayJoystick::ReplayJoystick(InputLog *log) {
+    events_ = log->events(log->joystickSource());
+    next_ = 0;
+    state_ = InputEvent();
+}
+
+bool ReplayJoystick::update(int button) {
+    long frame;
+    uint32_t call;
+    counter_.next(frame, call);
+    bool pressed = false;
+    while (next_ < events_.size() && events_[next_].before(frame, call)) {
+        const InputEvent &event = events_[next_++];
+        if (event.type == InputEvent::joystickState)
+            state_ = event;
+        else if (event.frame == frame && event.call == call && event.button == button)
+            pressed = true;
+    }
+    return pressed;
+}
+
+float ReplayJoystick::getAxis(int n) {
+    update();
+    return n >= 0 && n < (int) state_.axes.size() ? state_.axes[n] : 0.0f;
+}
+
+bool ReplayJoystick::getButton(int n) {
+    update();
+    return n >= 0 && n < 32 && ((state_.buttons >> n) & 1u);
+}
+
+bool ReplayJoystick::getButtonPress(int n) {
+    return update(n);
+}
+
+void ReplayJoystick::clearAllButtonPresses() {
+    update();
+}
+
+bool ReplayJoystick::isFound() {
+    update();
+    return state_.found;
+}
@@ -0,0 +1,115 @@
+#ifndef CUBECOMMON_JOYSTICKINPUT_H
+#define CUBECOMMON_JOYSTICKINPUT_H
+
+#include "InputLog.h"
+#include <Joystick.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Joystick interface of the apps, implemented by the real Joystick and by a script for headless runs.
+class JoystickInput {
+public:
+    virtual ~JoystickInput() = default;
+
+    virtual float getAxis(int n) = 0;
+    virtual bool getButton(int n) = 0;
+    /// true once per press, until it is read or cleared
+    virtual bool getButtonPress(int n) = 0;
+    virtual void clearAllButtonPresses() = 0;
+    virtual bool isFound() = 0;
+
+    /// a ReplayJoystick if CUBE_INPUT_REPLAY names an input log, a ScriptedJoystick if CUBE_JOYSTICK_SCRIPT names
+    /// a script, the real joystick otherwise. Wrapped in a RecordingJoystick if CUBE_INPUT_RECORD is set.
+    static JoystickInput *create(int number);
+};
+
+class LiveJoystick : public JoystickInput {
+public:
+    LiveJoystick(int number);
+
+    float getAxis(int n) override { return joystick_.getAxis(n); }
+    bool getButton(int n) override { return joystick_.getButton(n); }
+    bool getButtonPress(int n) override { return joystick_.getButtonPress(n); }
+    void clearAllButtonPresses() override { joystick_.clearAllButtonPresses(); }
+    bool isFound() override { return joystick_.isFound(); }
+
+private:
+    Joystick joystick_;
+};
+
+/// Replays a script of joystick states by frame number, see InputFrame.
+/// Script lines are "<frame> <joystick> <button mask> <axis 0> <axis 1> ...", a line sets the state of that
+/// joystick from its frame on. Joysticks without a line in the script report isFound() false.
+class ScriptedJoystick : public JoystickInput {
+public:
+    ScriptedJoystick(int number, const std::string &filename);
+
+    float getAxis(int n) override;
+    bool getButton(int n) override;
+    bool getButtonPress(int n) override;
+    void clearAllButtonPresses() override;
+    bool isFound() override;
+
+private:
+    struct State {
+        long frame;
+        uint32_t buttons;
+        std::vector<float> axes;
+    };
+
+    /// apply the script lines up to the current frame
+    void update();
+
+    std::vector<State> script_;
+    size_t next_;
+    State current_;
+    uint32_t presses_;
+};
+
+/// Logs what another joystick returns to the InputRecorder.
+class RecordingJoystick : public JoystickInput {
+public:
+    RecordingJoystick(JoystickInput *joystick, InputRecorder *recorder);
+
+    float getAxis(int n) override;
+    bool getButton(int n) override;
+    bool getButtonPress(int n) override;
+    void clearAllButtonPresses() override;
+    bool isFound() override;
+
+private:
+    /// frame and call of this call
+    void stamp();
+    /// log the state if it differs from the last logged one
+    void logState();
+
+    JoystickInput *joystick_;
+    InputRecorder *recorder_;
+    InputCallCounter counter_;
+    InputEvent state_;
+    InputEvent logged_;
+};
+
+/// Returns what a joystick returned while recording, call by call.
+class ReplayJoystick : public JoystickInput {
+public:
+    ReplayJoystick(InputLog *log);
+
+    float getAxis(int n) override;
+    bool getButton(int n) override;
+    bool getButtonPress(int n) override;
+    void clearAllButtonPresses() override;
+    bool isFound() override;
+
+private:
+    /// apply the logged events up to this call, true if it is a logged press of button
+    bool update(int button = -1);
+
+    std::vector<InputEvent> events_;
+    size_t next_;
+    InputCallCounter counter_;
+    InputEvent state_;
+};
+
+#endif //CUBECOMMON_JOYSTICKINPUT_H
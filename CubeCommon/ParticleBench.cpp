@@ -0,0 +1,139 @@
+#include "ParticleSystem.h"
+#include "ParticleKernels.h"
+#include "FastRandom.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+//steps a full PixelFlow sized pool on the cube surface with 1 to 4 threads
+//and prints ms per step, the speedup against one thread and a checksum that must not change with the thread count.
+//"particlebench check" instead compares the vectorized step with the scalar reference and fails on any difference
+
+//one copy of the particle arrays for the kernel check
+struct KernelState {
+    std::vector<float> px, py, pz, vx, vy, vz, ax, ay, az;
+    std::vector<int32_t> lastEdge;
+
+    ParticleKernels::SurfaceArrays arrays() {
+        return ParticleKernels::SurfaceArrays{px.data(), py.data(), pz.data(), vx.data(), vy.data(), vz.data(),
+                                              ax.data(), ay.data(), az.data(), lastEdge.data()};
+    }
+
+    bool operator==(const KernelState &other) const {
+        const std::vector<float> *mine[] = {&px, &py, &pz, &vx, &vy, &vz};
+        const std::vector<float> *theirs[] = {&other.px, &other.py, &other.pz, &other.vx, &other.vy, &other.vz};
+        for (int a = 0; a < 6; a++)
+            if (memcmp(mine[a]->data(), theirs[a]->data(), mine[a]->size() * sizeof(float)) != 0)
+                return false;
+        return lastEdge == other.lastEdge;
+    }
+};
+
+//seeded particles on all six screens, fast enough to cross edges often
+static KernelState kernelParticles(int count) {
+    FastRandom::Generator random(1234);
+    KernelState state;
+    std::vector<float> *arrays[] = {&state.px, &state.py, &state.pz, &state.vx, &state.vy, &state.vz,
+                                    &state.ax, &state.ay, &state.az};
+    for (std::vector<float> *array : arrays)
+        array->resize(count);
+    state.lastEdge.assign(count, 0);
+    for (int i = 0; i < count; i++) {
+        const int screen = random.below(6), fixed = screen / 2;
+        float p[3], v[3];
+        for (int axis = 0; axis < 3; axis++) {
+            p[axis] = 1 + random.unit() * (VIRTUALCUBEMAXINDEX - 2);
+            v[axis] = random.unit() * 3.0f - 1.5f;
+            (*arrays[6 + axis])[i] = random.unit() * 0.2f - 0.1f;
+        }
+        p[fixed] = screen % 2 ? VIRTUALCUBEMAXINDEX : 0;
+        v[fixed] = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            (*arrays[axis])[i] = p[axis];
+            (*arrays[3 + axis])[i] = v[axis];
+        }
+    }
+    return state;
+}
+
+//an odd count runs the scalar remainder of the vectorized path as well
+static bool checkKernels(int particles, int steps) {
+    KernelState simd = kernelParticles(particles);
+    KernelState scalar = simd;
+    for (int s = 0; s < steps; s++) {
+        ParticleKernels::stepOnSurface(simd.arrays(), 0, particles);
+        ParticleKernels::stepOnSurfaceScalar(scalar.arrays(), 0, particles);
+        if (simd == scalar)
+            continue;
+        for (int i = 0; i < particles; i++) {
+            if (simd.px[i] != scalar.px[i] || simd.py[i] != scalar.py[i] || simd.pz[i] != scalar.pz[i] ||
+                simd.vx[i] != scalar.vx[i] || simd.vy[i] != scalar.vy[i] || simd.vz[i] != scalar.vz[i] ||
+                simd.lastEdge[i] != scalar.lastEdge[i]) {
+                std::cout << ParticleKernels::simdName() << " differs from scalar at step " << s << ", particle " << i
+                          << ": " << simd.px[i] << " " << simd.py[i] << " " << simd.pz[i] << " edge "
+                          << simd.lastEdge[i] << " instead of " << scalar.px[i] << " " << scalar.py[i] << " "
+                          << scalar.pz[i] << " edge " << scalar.lastEdge[i] << std::endl;
+                return false;
+            }
+        }
+        //only a difference in a NaN payload gets here
+        std::cout << ParticleKernels::simdName() << " differs from scalar at step " << s << std::endl;
+        return false;
+    }
+    std::cout << ParticleKernels::simdName() << " matches scalar for " << particles << " particles, " << steps
+              << " steps" << std::endl;
+    return true;
+}
+
+static void fill(ParticleSystem &drops) {
+    drops.clear();
+    drops.seed(1234);
+    for (int i = 0; i < drops.capacity(); i++) {
+        Vector3f pos(rand() % VIRTUALCUBEMAXINDEX, rand() % VIRTUALCUBEMAXINDEX, 0);
+        Vector3f vel((rand() % 200 - 100) / 200.0f, (rand() % 200 - 100) / 200.0f, 0);
+        drops.spawn(pos, vel, Vector3f(0, 0, 0), Color(0, 0, 255));
+    }
+}
+
+static unsigned long checksum(ParticleSystem &drops) {
+    unsigned long sum = 1469598103934665603ul;
+    for (int i = 0; i < drops.span(); i++) {
+        Vector3i p = drops.iPosition(i);
+        sum = (sum ^ (unsigned long) (p[0] + 66 * p[1] + 66 * 66 * p[2])) * 1099511628211ul;
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "check") == 0)
+        return checkKernels(16384 + 5, 1000) ? 0 : 1;
+    int particles = argc > 1 ? atoi(argv[1]) : 16384;
+    int steps = argc > 2 ? atoi(argv[2]) : 1000;
+    ParticleSystem drops(particles);
+    Vector3f gravity(0.3f, -0.8f, 0.5f);
+    double singleThreadMs = 0;
+
+    std::cout << "particles " << particles << ", steps " << steps << ", simd " << ParticleKernels::simdName() << std::endl;
+    std::cout << "threads  ms/step  speedup  checksum" << std::endl;
+    for (int threads = 1; threads <= 4; threads++) {
+        WorkerPool pool(threads);
+        srand(1);
+        fill(drops);
+        drops.workers(&pool);
+        auto start = std::chrono::steady_clock::now();
+        for (int s = 0; s < steps; s++) {
+            drops.accelerateAll(gravity, -0.1f, -0.05f);
+            drops.stepOnSurface();
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        drops.workers(nullptr);
+        double ms = elapsed.count() / steps;
+        if (threads == 1)
+            singleThreadMs = ms;
+        std::cout << threads << "  " << ms << "  " << singleThreadMs / ms << "  " << std::hex << checksum(drops)
+                  << std::dec << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+#include "ParticleKernels.h"
+#include "CubeApplication.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Every lane type offers the same small set of operations. The kernel below is written once against them,
+// which keeps the scalar and the vector paths in lockstep.
+// Positions are never negative when they get rounded, so truncating x + 0.5 is the same as round(x).
+
+struct ScalarLanes {
+    static const int width = 1;
+    typedef float F;
+    typedef bool M;
+
+    static F load(const float *p) { return *p; }
+    static void store(float *p, F v) { *p = v; }
+    static F loadInt(const int32_t *p) { return (float) *p; }
+    static void storeInt(int32_t *p, F v) { *p = (int32_t) v; }
+    static F set(float v) { return v; }
+    static F add(F a, F b) { return a + b; }
+    static F neg(F a) { return -a; }
+    static F max(F a, F b) { return a > b ? a : b; }
+    static F min(F a, F b) { return a < b ? a : b; }
+    static F roundPositive(F a) { return (float) (int32_t) (a + 0.5f); }
+    static M eq(F a, F b) { return a == b; }
+    static M lt(F a, F b) { return a < b; }
+    static M gt(F a, F b) { return a > b; }
+    static M bitAnd(M a, M b) { return a && b; }
+    static M bitOr(M a, M b) { return a || b; }
+    static M andNot(M a, M b) { return !a && b; }
+    static F select(M m, F a, F b) { return m ? a : b; }
+};
+
+#if defined(__SSE2__)
+struct Vec4Lanes {
+    static const int width = 4;
+    typedef __m128 F;
+    typedef __m128 M;
+
+    static F load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, F v) { _mm_storeu_ps(p, v); }
+    static F loadInt(const int32_t *p) { return _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) p)); }
+    static void storeInt(int32_t *p, F v) { _mm_storeu_si128((__m128i *) p, _mm_cvttps_epi32(v)); }
+    static F set(float v) { return _mm_set1_ps(v); }
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F neg(F a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+    static F max(F a, F b) { return _mm_max_ps(a, b); }
+    static F min(F a, F b) { return _mm_min_ps(a, b); }
+    static F roundPositive(F a) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(a, _mm_set1_ps(0.5f)))); }
+    static M eq(F a, F b) { return _mm_cmpeq_ps(a, b); }
+    static M lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static M gt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+    static M bitAnd(M a, M b) { return _mm_and_ps(a, b); }
+    static M bitOr(M a, M b) { return _mm_or_ps(a, b); }
+    static M andNot(M a, M b) { return _mm_andnot_ps(a, b); }
+    static F select(M m, F a, F b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+};
+#elif defined(__ARM_NEON)
+struct Vec4Lanes {
+    static const int width = 4;
+    typedef float32x4_t F;
+    typedef uint32x4_t M;
+
+    static F load(const float *p) { return vld1q_f32(p); }
+    static void store(float *p, F v) { vst1q_f32(p, v); }
+    static F loadInt(const int32_t *p) { return vcvtq_f32_s32(vld1q_s32(p)); }
+    static void storeInt(int32_t *p, F v) { vst1q_s32(p, vcvtq_s32_f32(v)); }
+    static F set(float v) { return vdupq_n_f32(v); }
+    static F add(F a, F b) { return vaddq_f32(a, b); }
+    static F neg(F a) { return vnegq_f32(a); }
+    //compare and select instead of vmaxq/vminq to get the same signed zero handling as the other paths
+    static F max(F a, F b) { return vbslq_f32(vcgtq_f32(a, b), a, b); }
+    static F min(F a, F b) { return vbslq_f32(vcltq_f32(a, b), a, b); }
+    static F roundPositive(F a) { return vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(a, vdupq_n_f32(0.5f)))); }
+    static M eq(F a, F b) { return vceqq_f32(a, b); }
+    static M lt(F a, F b) { return vcltq_f32(a, b); }
+    static M gt(F a, F b) { return vcgtq_f32(a, b); }
+    static M bitAnd(M a, M b) { return vandq_u32(a, b); }
+    static M bitOr(M a, M b) { return vorrq_u32(a, b); }
+    static M andNot(M a, M b) { return vbicq_u32(b, a); }
+    static F select(M m, F a, F b) { return vbslq_f32(m, a, b); }
+};
+#endif
+
+#if defined(__AVX2__)
+struct Vec8Lanes {
+    static const int width = 8;
+    typedef __m256 F;
+    typedef __m256 M;
+
+    static F load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, F v) { _mm256_storeu_ps(p, v); }
+    static F loadInt(const int32_t *p) { return _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *) p)); }
+    static void storeInt(int32_t *p, F v) { _mm256_storeu_si256((__m256i *) p, _mm256_cvttps_epi32(v)); }
+    static F set(float v) { return _mm256_set1_ps(v); }
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F neg(F a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+    static F max(F a, F b) { return _mm256_max_ps(a, b); }
+    static F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static F roundPositive(F a) { return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(_mm256_add_ps(a, _mm256_set1_ps(0.5f)))); }
+    static M eq(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static M lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static M gt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static M bitAnd(M a, M b) { return _mm256_and_ps(a, b); }
+    static M bitOr(M a, M b) { return _mm256_or_ps(a, b); }
+    static M andNot(M a, M b) { return _mm256_andnot_ps(a, b); }
+    static F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+};
+#endif
+
+template<class L>
+static inline void stepSurfaceLanes(const ParticleKernels::SurfaceArrays &a, int i) {
+    typedef typename L::F F;
+    typedef typename L::M M;
+    const F zero = L::set(0.0f);
+    const F one = L::set(1.0f);
+    const F two = L::set(2.0f);
+    const F maxIndex = L::set((float) VIRTUALCUBEMAXINDEX);
+
+    F px = L::load(a.px + i), py = L::load(a.py + i), pz = L::load(a.pz + i);
+    F vx = L::load(a.vx + i), vy = L::load(a.vy + i), vz = L::load(a.vz + i);
+
+    //accelerate only along the screen the particle is on, screens are picked in the order left/right, front/back, top/bottom
+    F rx = L::roundPositive(px), ry = L::roundPositive(py), rz = L::roundPositive(pz);
+    M bx = L::bitOr(L::eq(rx, zero), L::eq(rx, maxIndex));
+    M by = L::bitOr(L::eq(ry, zero), L::eq(ry, maxIndex));
+    M bz = L::bitOr(L::eq(rz, zero), L::eq(rz, maxIndex));
+    vx = L::select(L::andNot(bx, L::bitOr(by, bz)), L::add(vx, L::load(a.ax + i)), vx);
+    vy = L::select(L::bitOr(bx, L::andNot(by, bz)), L::add(vy, L::load(a.ay + i)), vy);
+    vz = L::select(L::bitOr(bx, by), L::add(vz, L::load(a.az + i)), vz);
+
+    //move and constrain position values
+    px = L::min(maxIndex, L::max(zero, L::add(px, vx)));
+    py = L::min(maxIndex, L::max(zero, L::add(py, vy)));
+    pz = L::min(maxIndex, L::max(zero, L::add(pz, vz)));
+
+    //classify the edge in the same order as CubeTopology, vertical edges win over the top/bottom ones
+    rx = L::roundPositive(px);
+    ry = L::roundPositive(py);
+    rz = L::roundPositive(pz);
+    M zx = L::eq(rx, zero), mx = L::eq(rx, maxIndex);
+    M zy = L::eq(ry, zero), my = L::eq(ry, maxIndex);
+    M zz = L::eq(rz, zero), mz = L::eq(rz, maxIndex);
+    bx = L::bitOr(zx, mx);
+    by = L::bitOr(zy, my);
+    bz = L::bitOr(zz, mz);
+    M edgeXY = L::bitAnd(bx, by);
+    M edgeYZ = L::andNot(bx, L::bitAnd(by, bz));
+    M edgeXZ = L::andNot(by, L::bitAnd(bx, bz));
+    F sx = L::select(mx, one, zero), sy = L::select(my, one, zero), sz = L::select(mz, two, zero);
+    F edge = L::select(edgeXY, L::add(L::set(1.0f), L::add(sx, L::add(sy, sy))),
+                       L::select(edgeYZ, L::add(L::set(5.0f), L::add(sy, sz)),
+                                 L::select(edgeXZ, L::add(L::set(9.0f), L::add(sx, sz)), zero)));
+
+    //warp when entering a new edge
+    M entered = L::andNot(L::eq(edge, L::loadInt(a.lastEdge + i)), L::gt(edge, zero));
+    M swap = L::bitAnd(entered, edgeXY);
+    F t = vx;
+    vx = L::select(swap, vy, vx);
+    vy = L::select(swap, t, vy);
+    swap = L::bitAnd(entered, edgeYZ);
+    t = vz;
+    vz = L::select(swap, vy, vz);
+    vy = L::select(swap, t, vy);
+    swap = L::bitAnd(entered, edgeXZ);
+    t = vz;
+    vz = L::select(swap, vx, vz);
+    vx = L::select(swap, t, vx);
+
+    //set position to the rounded position to eliminate being always slightly below the surface due to rounding errors
+    px = L::select(entered, rx, px);
+    py = L::select(entered, ry, py);
+    pz = L::select(entered, rz, pz);
+
+    //constrain velocity directions, reflect if neccessary
+    M flip = L::bitAnd(entered, L::bitOr(L::bitAnd(zx, L::lt(vx, zero)), L::bitAnd(mx, L::gt(vx, zero))));
+    vx = L::select(flip, L::neg(vx), vx);
+    flip = L::bitAnd(entered, L::bitOr(L::bitAnd(zy, L::lt(vy, zero)), L::bitAnd(my, L::gt(vy, zero))));
+    vy = L::select(flip, L::neg(vy), vy);
+    flip = L::bitAnd(entered, L::bitOr(L::bitAnd(zz, L::lt(vz, zero)), L::bitAnd(mz, L::gt(vz, zero))));
+    vz = L::select(flip, L::neg(vz), vz);
+
+    L::store(a.px + i, px);
+    L::store(a.py + i, py);
+    L::store(a.pz + i, pz);
+    L::store(a.vx + i, vx);
+    L::store(a.vy + i, vy);
+    L::store(a.vz + i, vz);
+    L::storeInt(a.lastEdge + i, edge);
+}
+
+void ParticleKernels::stepOnSurface(const SurfaceArrays &arrays, int begin, int end) {
+    int i = begin;
+#if defined(__AVX2__)
+    for (; i + Vec8Lanes::width <= end; i += Vec8Lanes::width)
+        stepSurfaceLanes<Vec8Lanes>(arrays, i);
+#endif
+#if defined(__SSE2__) || defined(__ARM_NEON)
+    for (; i + Vec4Lanes::width <= end; i += Vec4Lanes::width)
+        stepSurfaceLanes<Vec4Lanes>(arrays, i);
+#endif
+    for (; i < end; i++)
+        stepSurfaceLanes<ScalarLanes>(arrays, i);
+}
+
+void ParticleKernels::stepOnSurfaceScalar(const SurfaceArrays &arrays, int begin, int end) {
+    for (int i = begin; i < end; i++)
+        stepSurfaceLanes<ScalarLanes>(arrays, i);
+}
+
+const char *ParticleKernels::simdName() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#elif defined(__ARM_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
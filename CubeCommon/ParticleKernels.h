@@ -0,0 +1,31 @@
+#ifndef CUBECOMMON_PARTICLEKERNELS_H
+#define CUBECOMMON_PARTICLEKERNELS_H
+
+#include <cstdint>
+
+/// Batch step kernels working directly on the ParticleSystem arrays.
+/// The kernels process 8 (AVX2) or 4 (SSE2, NEON) particles per iteration and fall back to a scalar
+/// path for the remainder and on targets without SIMD. All paths run the same operations in the same
+/// order, so they produce bit identical results.
+namespace ParticleKernels {
+
+    struct SurfaceArrays {
+        float *px, *py, *pz;
+        float *vx, *vy, *vz;
+        const float *ax, *ay, *az;
+        /// edge the particle was on after its last step, 0 for none
+        int32_t *lastEdge;
+    };
+
+    /// accelerate along the current screen, move, clamp to the cube and warp around the edges
+    /// for the particles in [begin, end)
+    void stepOnSurface(const SurfaceArrays &arrays, int begin, int end);
+
+    /// same as stepOnSurface() without SIMD, reference for the vectorized paths
+    void stepOnSurfaceScalar(const SurfaceArrays &arrays, int begin, int end);
+
+    /// instruction set the vectorized kernels were built for
+    const char *simdName();
+}
+
+#endif //CUBECOMMON_PARTICLEKERNELS_H
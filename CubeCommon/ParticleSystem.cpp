@@ -0,0 +1,344 @@
+#include "ParticleSystem.h"
+#include "ParticleKernels.h"
+#include <cmath>
+#include <algorithm>
+
+ParticleSystem::ParticleSystem(int capacity) {
+    capacity_ = capacity;
+    px_.resize(capacity_); py_.resize(capacity_); pz_.resize(capacity_);
+    vx_.resize(capacity_); vy_.resize(capacity_); vz_.resize(capacity_);
+    ax_.resize(capacity_); ay_.resize(capacity_); az_.resize(capacity_);
+    prevX_.resize(capacity_); prevY_.resize(capacity_); prevZ_.resize(capacity_);
+    drawX_.resize(capacity_); drawY_.resize(capacity_); drawZ_.resize(capacity_);
+    color_.resize(capacity_);
+    age_.resize(capacity_);
+    state_.resize(capacity_);
+    lastEdge_.resize(capacity_);
+    vxOld_.resize(capacity_);
+    vyOld_.resize(capacity_);
+    freeSlots_.reserve(capacity_);
+    highWaterMark_ = 0;
+    droppedSpawns_ = 0;
+    lifetime_ = 0;
+    workers_ = nullptr;
+    seed_ = 0x9e3779b9u;
+    frame_ = 0;
+    clear();
+}
+
+void ParticleSystem::lifetime(int steps) {
+    lifetime_ = steps;
+}
+
+int ParticleSystem::lifetime() {
+    return lifetime_;
+}
+
+void ParticleSystem::workers(WorkerPool *pool) {
+    workers_ = pool;
+}
+
+void ParticleSystem::seed(uint32_t seed) {
+    seed_ = seed;
+    frame_ = 0;
+}
+
+int ParticleSystem::spawn(Vector3f pos, Vector3f vel, Vector3f accel, Color col) {
+    if (freeSlots_.empty()) {
+        droppedSpawns_++;
+        return -1;
+    }
+    int i = freeSlots_.back();
+    freeSlots_.pop_back();
+
+    px_[i] = pos[0];
+    py_[i] = pos[1];
+    pz_[i] = pos[2];
+    prevX_[i] = pos[0];
+    prevY_[i] = pos[1];
+    prevZ_[i] = pos[2];
+    vx_[i] = vel[0];
+    vy_[i] = vel[1];
+    vz_[i] = vel[2];
+    ax_[i] = accel[0];
+    ay_[i] = accel[1];
+    az_[i] = accel[2];
+    color_[i] = col;
+    age_[i] = 0;
+    state_[i] = aliveSlot;
+    lastEdge_[i] = 0;
+    vxOld_[i] = 0.0f;
+    vyOld_[i] = 0.0f;
+
+    if (i >= span_)
+        span_ = i + 1;
+    count_++;
+    if (count_ > highWaterMark_)
+        highWaterMark_ = count_;
+    return i;
+}
+
+void ParticleSystem::clear() {
+    //lowest slot on top of the stack keeps the live particles packed at the front
+    freeSlots_.clear();
+    for (int i = capacity_ - 1; i >= 0; i--) {
+        state_[i] = freeSlot;
+        freeSlots_.push_back(i);
+    }
+    span_ = 0;
+    count_ = 0;
+}
+
+int ParticleSystem::capacity() {
+    return capacity_;
+}
+
+int ParticleSystem::count() {
+    return count_;
+}
+
+int ParticleSystem::span() {
+    return span_;
+}
+
+int ParticleSystem::highWaterMark() {
+    return highWaterMark_;
+}
+
+long ParticleSystem::droppedSpawns() {
+    return droppedSpawns_;
+}
+
+//multiple of the widest SIMD batch, so only the last chunk has a scalar remainder
+static const int chunkSize = 2048;
+
+static inline uint32_t mix32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float ParticleSystem::jitter(int i, uint32_t stream) {
+    uint32_t h = mix32((uint32_t) i * 0x9e3779b9u + mix32(seed_ + frame_ * 0x85ebca6bu + stream));
+    return (float) (h >> 8) * (1.0f / 16777216.0f);
+}
+
+void ParticleSystem::forEachChunk(const std::function<void(int, int)> &job) {
+    if (workers_ != nullptr)
+        workers_->parallelFor(span_, chunkSize, job);
+    else if (span_ > 0)
+        job(0, span_);
+}
+
+void ParticleSystem::accelerateAll(Vector3f accel, float minScale, float maxScale) {
+    const float range = maxScale - minScale;
+    forEachChunk([&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (state_[i] != aliveSlot)
+                continue;
+            float scale = minScale + range * jitter(i, 0);
+            ax_[i] = accel[0] * scale;
+            ay_[i] = accel[1] * scale;
+            az_[i] = accel[2] * scale;
+        }
+    });
+}
+
+void ParticleSystem::stepOnSurface() {
+    ParticleKernels::SurfaceArrays arrays = {px_.data(), py_.data(), pz_.data(),
+                                             vx_.data(), vy_.data(), vz_.data(),
+                                             ax_.data(), ay_.data(), az_.data(),
+                                             lastEdge_.data()};
+    //free slots below span_ are stepped as well, that is cheaper than masking them out and they get overwritten on spawn
+    forEachChunk([&](int begin, int end) {
+        keepPrevious(begin, end);
+        ParticleKernels::stepOnSurface(arrays, begin, end);
+        expire(begin, end);
+    });
+    frame_++;
+}
+
+void ParticleSystem::keepPrevious(int begin, int end) {
+    std::copy(px_.begin() + begin, px_.begin() + end, prevX_.begin() + begin);
+    std::copy(py_.begin() + begin, py_.begin() + end, prevY_.begin() + begin);
+    std::copy(pz_.begin() + begin, pz_.begin() + end, prevZ_.begin() + begin);
+}
+
+void ParticleSystem::expire(int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        if (state_[i] != aliveSlot)
+            continue;
+        if (lifetime_ > 0 && age_[i] > lifetime_)
+            state_[i] = deadSlot;
+        age_[i]++;
+    }
+}
+
+void ParticleSystem::stepSpill(float oversamplingFactor) {
+    forEachChunk([&](int begin, int end) {
+        keepPrevious(begin, end);
+        stepSpill(begin, end, oversamplingFactor);
+        expire(begin, end);
+    });
+    frame_++;
+}
+
+void ParticleSystem::stepSpill(int begin, int end, float oversamplingFactor) {
+    const float maxPos = VIRTUALCUBEMAXINDEX;
+    for (int i = begin; i < end; i++) {
+        if (state_[i] != aliveSlot)
+            continue;
+        vx_[i] += ax_[i];
+        vy_[i] += ay_[i];
+        vz_[i] += az_[i];
+        px_[i] += vx_[i];
+        py_[i] += vy_[i];
+        pz_[i] += vz_[i];
+
+        //left the top screen, start falling down the side
+        if (px_[i] < 0 || py_[i] < 0 || px_[i] > maxPos || py_[i] > maxPos) {
+            vz_[i] = 0.3f * oversamplingFactor;
+            az_[i] = (0.02f + (float) (int) (jitter(i, 1) * 10.0f) / 400.0f) * oversamplingFactor;
+            ay_[i] = 0;
+            ax_[i] = 0;
+            if (vxOld_[i] == 0 && vyOld_[i] == 0) {
+                vxOld_[i] = vx_[i];
+                vyOld_[i] = vy_[i];
+            }
+            vx_[i] = 0;
+            vy_[i] = 0;
+        }
+
+        if (px_[i] < 0) {
+            px_[i] = 0;
+            pz_[i] = 0;
+        }
+        if (py_[i] < 0) {
+            py_[i] = 0;
+            pz_[i] = 0;
+        }
+        if (px_[i] > maxPos) {
+            px_[i] = maxPos;
+            pz_[i] = 0;
+        }
+        if (py_[i] > maxPos) {
+            py_[i] = maxPos;
+            pz_[i] = 0;
+        }
+        if (pz_[i] < 0) {
+            pz_[i] = 0;
+            vz_[i] *= -1;
+        }
+
+        //reached the bottom, creep back towards the center
+        if (pz_[i] > maxPos) {
+            pz_[i] = maxPos;
+            vx_[i] = vxOld_[i] * -1;
+            vy_[i] = vyOld_[i] * -1;
+            vz_[i] = 0;
+            ax_[i] = 0;
+            ay_[i] = 0;
+            az_[i] = 0;
+        }
+        if (((vx_[i] > 0 && px_[i] > VIRTUALCUBECENTER) || (vx_[i] < 0 && px_[i] < VIRTUALCUBECENTER)) && pz_[i] == maxPos) {
+            vx_[i] = 0;
+            vxOld_[i] = 0;
+        }
+        if (((vy_[i] > 0 && py_[i] > VIRTUALCUBECENTER) || (vy_[i] < 0 && py_[i] < VIRTUALCUBECENTER)) && pz_[i] == maxPos) {
+            vy_[i] = 0;
+            vyOld_[i] = 0;
+        }
+        if (vx_[i] == 0 && vy_[i] == 0 && pz_[i] == maxPos)
+            state_[i] = deadSlot;
+    }
+}
+
+void ParticleSystem::render(CubeApplication *ca) {
+    //drawn on the calling thread in slot order, so overlapping particles always resolve the same way
+    const int n = span_;
+    for (int i = 0; i < n; i++) {
+        if (state_[i] == freeSlot)
+            continue;
+        ca->setPixel3D(iPosition(i), color_[i]);
+    }
+}
+
+void ParticleSystem::render(TrailBuffer &trail) {
+    const int n = span_;
+    for (int i = 0; i < n; i++) {
+        if (state_[i] != freeSlot)
+            trail.setPixel3D(iPosition(i), color_[i]);
+    }
+}
+
+void ParticleSystem::renderSmooth(TrailBuffer &trail) {
+    //state_ is 0 for free slots only
+    static_assert(freeSlot == 0, "splat mask");
+    trail.splat(px_.data(), py_.data(), pz_.data(), color_.data(), span_, state_.data());
+}
+
+void ParticleSystem::renderInterpolated(TrailBuffer &trail, float alpha) {
+    const int n = span_;
+    for (int i = 0; i < n; i++) {
+        drawX_[i] = prevX_[i] + (px_[i] - prevX_[i]) * alpha;
+        drawY_[i] = prevY_[i] + (py_[i] - prevY_[i]) * alpha;
+        drawZ_[i] = prevZ_[i] + (pz_[i] - prevZ_[i]) * alpha;
+    }
+    //the line between two positions around an edge cuts through the cube, splat() snaps it back to the nearest screen
+    trail.splat(drawX_.data(), drawY_.data(), drawZ_.data(), color_.data(), n, state_.data());
+}
+
+void ParticleSystem::recycleDead() {
+    //walk downwards so the lowest free slot ends up on top of the stack
+    for (int i = span_ - 1; i >= 0; i--) {
+        if (state_[i] == deadSlot) {
+            state_[i] = freeSlot;
+            freeSlots_.push_back(i);
+            count_--;
+        }
+    }
+    while (span_ > 0 && state_[span_ - 1] == freeSlot)
+        span_--;
+}
+
+Vector3f ParticleSystem::position(int i) {
+    return Vector3f(px_[i], py_[i], pz_[i]);
+}
+
+Vector3f ParticleSystem::velocity(int i) {
+    return Vector3f(vx_[i], vy_[i], vz_[i]);
+}
+
+Vector3f ParticleSystem::acceleration(int i) {
+    return Vector3f(ax_[i], ay_[i], az_[i]);
+}
+
+Vector3i ParticleSystem::iPosition(int i) {
+    //positions never leave [0, VIRTUALCUBEMAXINDEX], rounding the same way as the step kernels
+    return Vector3i((int) (px_[i] + 0.5f), (int) (py_[i] + 0.5f), (int) (pz_[i] + 0.5f));
+}
+
+Color ParticleSystem::color(int i) {
+    return color_[i];
+}
+
+int ParticleSystem::age(int i) {
+    return age_[i];
+}
+
+bool ParticleSystem::isAlive(int i) {
+    return state_[i] == aliveSlot;
+}
+
+bool ParticleSystem::isDead(int i) {
+    return state_[i] == deadSlot;
+}
+
+void ParticleSystem::acceleration(int i, Vector3f accel) {
+    ax_[i] = accel[0];
+    ay_[i] = accel[1];
+    az_[i] = accel[2];
+}
@@ -0,0 +1,114 @@
+#ifndef CUBECOMMON_PARTICLESYSTEM_H
+#define CUBECOMMON_PARTICLESYSTEM_H
+
+#include "CubeApplication.h"
+#include "TrailBuffer.h"
+#include "WorkerPool.h"
+#include <vector>
+#include <cstdint>
+
+/// Particle engine shared by the PixelFlow and Rainbow effects.
+/// Every particle field lives in its own contiguous array (structure of arrays),
+/// so the step kernels below walk memory linearly instead of chasing one heap object per drop.
+/// The arrays are a fixed-capacity pool allocated once, freed slots are recycled through a free list,
+/// so spawning and expiring particles never touches the heap.
+/// With a WorkerPool attached the steps run in chunks on several cores. Random jitter is derived from
+/// the slot, the step and the seed instead of a shared generator, so the result does not depend on the thread count.
+class ParticleSystem {
+public:
+    ParticleSystem(int capacity);
+
+    /// particles older than this many steps are removed, 0 keeps them forever
+    void lifetime(int steps);
+    int lifetime();
+
+    /// split the steps over the threads of pool, nullptr steps on the calling thread only
+    void workers(WorkerPool *pool);
+    /// seed of the per particle jitter, restarts its sequence
+    void seed(uint32_t seed);
+
+    /// returns the slot of the new particle or -1 if the pool is exhausted
+    int spawn(Vector3f pos, Vector3f vel, Vector3f accel, Color col);
+    void clear();
+
+    int capacity();
+    /// number of live particles
+    int count();
+    /// all live particles have a slot below span(), iterate [0, span()) and skip !isAlive(i)
+    int span();
+    /// most particles that were alive at the same time, use it to size the pool per effect
+    int highWaterMark();
+    /// spawns rejected because the pool was full
+    long droppedSpawns();
+
+    /// set the acceleration of every live particle to accel scaled by a random factor in [minScale, maxScale)
+    void accelerateAll(Vector3f accel, float minScale, float maxScale);
+    /// slide on the cube surface and wrap around the edges (PixelFlow, PixelFlow2)
+    void stepOnSurface();
+    /// slide over the top, fall down the sides and creep back to the center of the bottom (PixelFlow3, Rainbow)
+    void stepSpill(float oversamplingFactor = 1.0f);
+
+    void render(CubeApplication *ca);
+    /// draw into a trail that decays instead of straight onto the cube
+    void render(TrailBuffer &trail);
+    /// anti-aliased version of render(), splats the float positions of the whole pool in one batch
+    void renderSmooth(TrailBuffer &trail);
+    /// renderSmooth() at alpha between the positions before and after the last step, see FixedTimestep::alpha()
+    void renderInterpolated(TrailBuffer &trail, float alpha);
+    /// return the particles that expired during this step to the free list
+    void recycleDead();
+
+    Vector3f position(int i);
+    Vector3f velocity(int i);
+    Vector3f acceleration(int i);
+    Vector3i iPosition(int i);
+    Color color(int i);
+    int age(int i);
+    bool isAlive(int i);
+    bool isDead(int i);
+
+    void acceleration(int i, Vector3f accel);
+
+private:
+    /// remember the positions in [begin, end) for renderInterpolated()
+    void keepPrevious(int begin, int end);
+    /// expire and age the live particles in [begin, end)
+    void expire(int begin, int end);
+    void stepSpill(int begin, int end, float oversamplingFactor);
+    /// uniform in [0, 1) for slot i in the current step
+    float jitter(int i, uint32_t stream);
+    /// runs job over [0, span_) on the worker pool if there is one
+    void forEachChunk(const std::function<void(int, int)> &job);
+
+    enum SlotState : uint8_t {
+        freeSlot, aliveSlot, deadSlot
+    };
+
+    std::vector<float> px_, py_, pz_;
+    std::vector<float> vx_, vy_, vz_;
+    std::vector<float> ax_, ay_, az_;
+    //positions before the last step and the interpolated ones handed to the trail
+    std::vector<float> prevX_, prevY_, prevZ_;
+    std::vector<float> drawX_, drawY_, drawZ_;
+    std::vector<Color> color_;
+    std::vector<int> age_;
+    std::vector<uint8_t> state_;
+    //stepOnSurface state
+    std::vector<int32_t> lastEdge_;
+    //stepSpill state
+    std::vector<float> vxOld_, vyOld_;
+
+    std::vector<int> freeSlots_;
+    int capacity_;
+    int span_;
+    int count_;
+    int highWaterMark_;
+    long droppedSpawns_;
+    int lifetime_;
+
+    WorkerPool *workers_;
+    uint32_t seed_;
+    uint32_t frame_;
+};
+
+#endif //CUBECOMMON_PARTICLESYSTEM_H
@@ -0,0 +1,141 @@
+#include "PhaseTimer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+PhaseHistogram::PhaseHistogram(const std::string &name) : name_(name), counts_(buckets, 0) {
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+}
+
+int PhaseHistogram::bucket(uint64_t value) {
+    if (value < (1u << subBucketBits))
+        return (int) value;
+    const uint64_t limit = (1ull << maxBits) - 1;
+    value = std::min(value, limit);
+    //position of the highest bit selects the power of two, the bits below it the sub bucket
+    int highest = 63 - __builtin_clzll(value);
+    int subBucket = (int) (value >> (highest - subBucketBits)) - (1 << subBucketBits);
+    return ((highest - subBucketBits + 1) << subBucketBits) + subBucket;
+}
+
+uint64_t PhaseHistogram::bucketStart(int bucket) {
+    if (bucket < (1 << subBucketBits))
+        return (uint64_t) bucket;
+    int highest = (bucket >> subBucketBits) + subBucketBits - 1;
+    uint64_t mantissa = (uint64_t) ((bucket & ((1 << subBucketBits) - 1)) + (1 << subBucketBits));
+    return mantissa << (highest - subBucketBits);
+}
+
+void PhaseHistogram::record(std::chrono::nanoseconds duration) {
+    uint64_t value = (uint64_t) std::max<int64_t>(duration.count(), 0);
+    counts_[bucket(value)]++;
+    count_++;
+    sum_ += value;
+    max_ = std::max(max_, value);
+}
+
+const std::string &PhaseHistogram::name() const {
+    return name_;
+}
+
+uint64_t PhaseHistogram::count() const {
+    return count_;
+}
+
+uint64_t PhaseHistogram::sum() const {
+    return sum_;
+}
+
+double PhaseHistogram::mean() const {
+    return count_ > 0 ? (double) sum_ / count_ : 0;
+}
+
+uint64_t PhaseHistogram::max() const {
+    return max_;
+}
+
+uint64_t PhaseHistogram::percentile(double p) const {
+    uint64_t rank = std::max<uint64_t>((uint64_t) (p * count_ + 0.999999), 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < buckets; i++) {
+        seen += counts_[i];
+        if (seen >= rank)
+            return bucketStart(i);
+    }
+    return 0;
+}
+
+uint64_t PhaseHistogram::bucketCount(int bucket) const {
+    return counts_[bucket];
+}
+
+std::vector<PhaseHistogram *> PhaseTimers::phases_;
+volatile std::sig_atomic_t PhaseTimers::dumpRequested_ = 0;
+PhaseTimers::Clock::time_point PhaseTimers::nextDump_ = PhaseTimers::Clock::time_point::max();
+PhaseTimers::Clock::duration PhaseTimers::interval_ = PhaseTimers::Clock::duration::zero();
+PhaseTimers::Clock::time_point PhaseTimers::start_;
+std::string PhaseTimers::filename_;
+
+void PhaseTimers::init() {
+    start_ = Clock::now();
+    const char *file = getenv("CUBE_TIMERS_FILE");
+    filename_ = file != nullptr ? file : std::string("/tmp/") + program_invocation_short_name + ".timers";
+    const char *interval = getenv("CUBE_TIMERS_INTERVAL");
+    if (interval != nullptr && atof(interval) > 0) {
+        interval_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(atof(interval)));
+        nextDump_ = start_ + interval_;
+    }
+    std::signal(SIGUSR1, requestDump);
+}
+
+void PhaseTimers::requestDump(int) {
+    dumpRequested_ = 1;
+}
+
+PhaseHistogram &PhaseTimers::phase(const std::string &name) {
+    if (phases_.empty())
+        init();
+    for (PhaseHistogram *phase : phases_) {
+        if (phase->name() == name)
+            return *phase;
+    }
+    phases_.push_back(new PhaseHistogram(name));
+    return *phases_.back();
+}
+
+void PhaseTimers::dump() {
+    dumpRequested_ = 0;
+    const Clock::time_point now = Clock::now();
+    if (interval_ > Clock::duration::zero())
+        nextDump_ = now + interval_;
+
+    //written next to the target and renamed, a reader never sees half a file
+    const std::string temporary = filename_ + ".tmp";
+    std::ofstream file(temporary);
+    file << std::fixed << std::setprecision(1);
+    file << "# " << std::chrono::duration<double>(now - start_).count() << "s since start, times in microseconds" << std::endl;
+    file << "# phase count mean p50 p90 p99 p99.9 max" << std::endl;
+    for (PhaseHistogram *phase : phases_) {
+        file << phase->name() << " " << phase->count() << " " << phase->mean() / 1000 << " "
+             << phase->percentile(0.5) / 1000.0 << " " << phase->percentile(0.9) / 1000.0 << " "
+             << phase->percentile(0.99) / 1000.0 << " " << phase->percentile(0.999) / 1000.0 << " "
+             << phase->max() / 1000.0 << std::endl;
+    }
+    file << std::setprecision(3);
+    for (PhaseHistogram *phase : phases_) {
+        file << std::endl << "# " << phase->name() << " histogram: bucket start, count" << std::endl;
+        for (int i = 0; i < PhaseHistogram::buckets; i++) {
+            if (phase->bucketCount(i) > 0)
+                file << PhaseHistogram::bucketStart(i) / 1000.0 << " " << phase->bucketCount(i) << std::endl;
+        }
+    }
+    file.close();
+    if (!file || std::rename(temporary.c_str(), filename_.c_str()) != 0)
+        std::cout << "could not write phase timers to " << filename_ << std::endl;
+}
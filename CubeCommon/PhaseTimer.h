@@ -0,0 +1,100 @@
+#ifndef CUBECOMMON_PHASETIMER_H
+#define CUBECOMMON_PHASETIMER_H
+
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Log-linear histogram of durations, 16 buckets per power of two (about 6% resolution) from 1ns to about 18 minutes.
+/// record() is a clz and an increment, the histogram is meant to stay on in production.
+class PhaseHistogram {
+public:
+    PhaseHistogram(const std::string &name);
+
+    void record(std::chrono::nanoseconds duration);
+
+    const std::string &name() const;
+    uint64_t count() const;
+    /// of all recorded durations, in nanoseconds
+    uint64_t sum() const;
+    /// in nanoseconds
+    double mean() const;
+    uint64_t max() const;
+    /// lower bound of the bucket containing the p-quantile, in nanoseconds
+    uint64_t percentile(double p) const;
+
+    static const int subBucketBits = 4;
+    static const int maxBits = 40;
+    static const int buckets = (maxBits - subBucketBits + 2) << subBucketBits;
+
+    static int bucket(uint64_t value);
+    /// smallest value in bucket
+    static uint64_t bucketStart(int bucket);
+    uint64_t bucketCount(int bucket) const;
+
+private:
+    std::string name_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t max_;
+    std::vector<uint64_t> counts_;
+};
+
+/// Registry of the per-phase histograms of an app.
+/// The histograms are written to CUBE_TIMERS_FILE (default /tmp/<program>.timers) when the process gets SIGUSR1,
+/// and every CUBE_TIMERS_INTERVAL seconds if that is set. The file is written by the next timer that ends,
+/// so the signal handler itself only sets a flag. Timers are meant for the loop() thread only.
+class PhaseTimers {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /// the histogram of a phase, created on first use
+    static PhaseHistogram &phase(const std::string &name);
+
+    /// write all histograms now
+    static void dump();
+
+    /// called when a timer ends
+    static void check(Clock::time_point now) {
+        if (dumpRequested_ || now >= nextDump_)
+            dump();
+    }
+
+private:
+    static void init();
+    static void requestDump(int);
+
+    static std::vector<PhaseHistogram *> phases_;
+    static volatile std::sig_atomic_t dumpRequested_;
+    static Clock::time_point nextDump_;
+    static Clock::duration interval_;
+    static Clock::time_point start_;
+    static std::string filename_;
+};
+
+/// Records the time until the end of the scope in a phase histogram.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(PhaseHistogram &phase) : phase_(phase), start_(PhaseTimers::Clock::now()) {}
+
+    ~ScopedTimer() {
+        PhaseTimers::Clock::time_point end = PhaseTimers::Clock::now();
+        phase_.record(end - start_);
+        PhaseTimers::check(end);
+    }
+
+private:
+    PhaseHistogram &phase_;
+    PhaseTimers::Clock::time_point start_;
+};
+
+#define PHASE_TIMER_CONCAT2(a, b) a##b
+#define PHASE_TIMER_CONCAT(a, b) PHASE_TIMER_CONCAT2(a, b)
+/// times the rest of the enclosing scope as phase name, the histogram is looked up once per call site
+#define PHASE_TIMER(name) \
+    static PhaseHistogram &PHASE_TIMER_CONCAT(phaseHistogram, __LINE__) = PhaseTimers::phase(name); \
+    ScopedTimer PHASE_TIMER_CONCAT(phaseTimer, __LINE__)(PHASE_TIMER_CONCAT(phaseHistogram, __LINE__))
+
+#endif //CUBECOMMON_PHASETIMER_H
@@ -0,0 +1,85 @@
+#include "PngWriter.h"
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+    uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+        static uint32_t table[256];
+        static bool initialized = false;
+        if (!initialized) {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1u) ? 0xEDB88320u ^ (c >> 1u) : c >> 1u;
+                table[i] = c;
+            }
+            initialized = true;
+        }
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+            crc = table[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8u);
+        return ~crc;
+    }
+
+    void putBigEndian(std::vector<uint8_t> &out, uint32_t value) {
+        out.push_back((uint8_t) (value >> 24u));
+        out.push_back((uint8_t) (value >> 16u));
+        out.push_back((uint8_t) (value >> 8u));
+        out.push_back((uint8_t) value);
+    }
+
+    void writeChunk(std::ofstream &file, const char *type, const std::vector<uint8_t> &data) {
+        std::vector<uint8_t> chunk;
+        putBigEndian(chunk, (uint32_t) data.size());
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        putBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+        file.write((const char *) chunk.data(), chunk.size());
+    }
+}
+
+bool PngWriter::write(const std::string &filename, int width, int height, const std::vector<uint8_t> &rgb) {
+    if (width <= 0 || height <= 0 || rgb.size() < (size_t) width * height * 3)
+        return false;
+
+    //every row starts with filter type 0
+    std::vector<uint8_t> raw;
+    raw.reserve((size_t) height * (width * 3 + 1));
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + (size_t) y * width * 3, rgb.begin() + (size_t) (y + 1) * width * 3);
+    }
+
+    //zlib stream of stored blocks of at most 65535 bytes
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    uint32_t adlerA = 1, adlerB = 0;
+    for (size_t offset = 0; offset < raw.size(); offset += 65535) {
+        uint16_t size = (uint16_t) std::min<size_t>(65535, raw.size() - offset);
+        uint16_t inverted = (uint16_t) ~size;
+        zlib.push_back(offset + size == raw.size() ? 1 : 0);
+        zlib.push_back((uint8_t) size);
+        zlib.push_back((uint8_t) (size >> 8u));
+        zlib.push_back((uint8_t) inverted);
+        zlib.push_back((uint8_t) (inverted >> 8u));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+    }
+    for (uint8_t byte : raw) {
+        adlerA = (adlerA + byte) % 65521;
+        adlerB = (adlerB + adlerA) % 65521;
+    }
+    putBigEndian(zlib, (adlerB << 16u) | adlerA);
+
+    std::vector<uint8_t> header;
+    putBigEndian(header, (uint32_t) width);
+    putBigEndian(header, (uint32_t) height);
+    header.insert(header.end(), {8, 2, 0, 0, 0}); //8 bit, RGB, deflate, no filter, no interlace
+
+    std::ofstream file(filename, std::ios::binary);
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file.write((const char *) signature, sizeof(signature));
+    writeChunk(file, "IHDR", header);
+    writeChunk(file, "IDAT", zlib);
+    writeChunk(file, "IEND", std::vector<uint8_t>());
+    return (bool) file;
+}
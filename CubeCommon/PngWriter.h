@@ -0,0 +1,16 @@
+#ifndef CUBECOMMON_PNGWRITER_H
+#define CUBECOMMON_PNGWRITER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Writes 8 bit RGB PNGs without zlib, the image data goes into stored (uncompressed) deflate blocks.
+/// The files are about as large as the raw pixels, good enough for a few debug frames.
+namespace PngWriter {
+
+    /// rgb holds width * height pixels, rows from the top
+    bool write(const std::string &filename, int width, int height, const std::vector<uint8_t> &rgb);
+}
+
+#endif //CUBECOMMON_PNGWRITER_H
@@ -0,0 +1,69 @@
+#include "SpawnController.h"
+#include <algorithm>
+#include <cmath>
+
+//weight of the newest frame in the smoothed frame time
+static const float smoothing = 0.1f;
+//density change per frame for a frame time off by 100%
+static const float gain = 0.02f;
+
+float SpawnController::heldDensity_ = -1;
+
+SpawnController::SpawnController(int fps, int minSpawn, int maxSpawn, int minLifetime, int maxLifetime) {
+    minSpawn_ = minSpawn;
+    maxSpawn_ = maxSpawn;
+    minLifetime_ = minLifetime;
+    maxLifetime_ = maxLifetime;
+    targetMs_ = 0.8f * 1000.0f / (float) fps;
+    smoothedMs_ = 0;
+    density_ = 0.5f;
+    start_ = std::chrono::steady_clock::now();
+}
+
+void SpawnController::targetFrameTime(float ms) {
+    targetMs_ = ms;
+}
+
+float SpawnController::targetFrameTime() const {
+    return targetMs_;
+}
+
+void SpawnController::frameStart() {
+    start_ = std::chrono::steady_clock::now();
+}
+
+void SpawnController::frameEnd() {
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start_;
+    if (smoothedMs_ == 0)
+        smoothedMs_ = elapsed.count();
+    else
+        smoothedMs_ += smoothing * (elapsed.count() - smoothedMs_);
+
+    //proportional step, capped so one slow frame can not empty the cube
+    float error = 1.0f - smoothedMs_ / targetMs_;
+    density_ += gain * std::max(-1.0f, std::min(1.0f, error));
+    density_ = std::max(0.0f, std::min(1.0f, density_));
+    if (heldDensity_ >= 0)
+        density_ = heldDensity_;
+}
+
+int SpawnController::spawnRate() const {
+    return minSpawn_ + (int) std::lround(density() * (float) (maxSpawn_ - minSpawn_));
+}
+
+int SpawnController::lifetime() const {
+    return minLifetime_ + (int) std::lround(density() * (float) (maxLifetime_ - minLifetime_));
+}
+
+float SpawnController::frameTime() const {
+    return smoothedMs_;
+}
+
+float SpawnController::density() const {
+    //a density held since before the first frameEnd() counts right away
+    return heldDensity_ >= 0 ? heldDensity_ : density_;
+}
+
+void SpawnController::holdDensity(float density) {
+    heldDensity_ = std::min(1.0f, density);
+}
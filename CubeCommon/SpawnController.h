@@ -0,0 +1,45 @@
+#ifndef CUBECOMMON_SPAWNCONTROLLER_H
+#define CUBECOMMON_SPAWNCONTROLLER_H
+
+#include <chrono>
+
+/// Scales the spawn rate and lifetime of a particle effect to hold a target frame time.
+/// frameStart()/frameEnd() measure the work of one loop(), a smoothed value of it drives a density
+/// between 0 (minimum spawns and lifetime) and 1 (maximum spawns and lifetime).
+class SpawnController {
+public:
+    /// starts in the middle of the bounds, the target is 80% of the frame period at fps
+    SpawnController(int fps, int minSpawn, int maxSpawn, int minLifetime = 0, int maxLifetime = 0);
+
+    void targetFrameTime(float ms);
+    float targetFrameTime() const;
+
+    void frameStart();
+    /// call before render(), that may wait for the display
+    void frameEnd();
+
+    /// particles to spawn this frame
+    int spawnRate() const;
+    /// particle lifetime in steps, 0 if the effect has no lifetime bounds
+    int lifetime() const;
+    /// smoothed work per frame in ms
+    float frameTime() const;
+    /// the held density while one is held, otherwise the adapted one
+    float density() const;
+
+    /// holds the density of all controllers at density instead of adapting it, a negative value adapts again.
+    /// The headless runner holds it, the work per frame would depend on the speed of the machine otherwise
+    static void holdDensity(float density);
+
+private:
+    int minSpawn_, maxSpawn_;
+    int minLifetime_, maxLifetime_;
+    float targetMs_;
+    float smoothedMs_;
+    float density_;
+    std::chrono::steady_clock::time_point start_;
+
+    static float heldDensity_;
+};
+
+#endif //CUBECOMMON_SPAWNCONTROLLER_H
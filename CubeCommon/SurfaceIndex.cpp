@@ -0,0 +1,36 @@
+#include "SurfaceIndex.h"
+
+const SurfaceIndex &SurfaceIndex::instance() {
+    static const SurfaceIndex index;
+    return index;
+}
+
+SurfaceIndex::SurfaceIndex() {
+    voxelToIndex_.assign(edge * edge * edge, -1);
+    for (int z = 0; z < edge; z++) {
+        for (int y = 0; y < edge; y++) {
+            for (int x = 0; x < edge; x++) {
+                if (x != 0 && y != 0 && z != 0 && x != VIRTUALCUBEMAXINDEX && y != VIRTUALCUBEMAXINDEX &&
+                    z != VIRTUALCUBEMAXINDEX)
+                    continue;
+                voxelToIndex_[x + edge * (y + edge * z)] = (int32_t) position_.size();
+                position_.push_back(Vector3i(x, y, z));
+            }
+        }
+    }
+
+    const int n = (int) position_.size();
+    neighbor_.resize(n * directions);
+    edge_.resize(n);
+    for (int i = 0; i < n; i++) {
+        int faces = 0;
+        for (int d = 0; d < directions; d++) {
+            Vector3i next = position_[i];
+            next[axisOf(d)] += signOf(d);
+            neighbor_[i * directions + d] = indexOf(next);
+            if (next[axisOf(d)] < 0 || next[axisOf(d)] > VIRTUALCUBEMAXINDEX)
+                faces++;
+        }
+        edge_[i] = faces > 1;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef CUBECOMMON_SURFACEINDEX_H
+#define CUBECOMMON_SURFACEINDEX_H
+
+#include "CubeApplication.h"
+#include <cstdint>
+#include <vector>
+
+/// Dense numbering of the 25352 voxels on the surface of the virtual cube, x fastest, then y, then z.
+/// The numbers fit in 16 bits, per voxel state can live in plain arrays indexed by them.
+/// Neighbors are the six axis steps that stay on the surface, an edge is crossed through the voxel both screens share.
+class SurfaceIndex {
+public:
+    enum Direction {
+        plusX, minusX, plusY, minusY, plusZ, minusZ, directions
+    };
+
+    static const SurfaceIndex &instance();
+
+    int size() const { return (int) position_.size(); }
+
+    /// -1 if point is not on the surface
+    int indexOf(const Vector3i &point) const {
+        for (int axis = 0; axis < 3; axis++)
+            if (point[axis] < 0 || point[axis] > VIRTUALCUBEMAXINDEX)
+                return -1;
+        return voxelToIndex_[point[0] + edge * (point[1] + edge * point[2])];
+    }
+
+    const Vector3i &position(int index) const { return position_[index]; }
+
+    /// index of the neighbor in direction, -1 off the surface
+    int neighbor(int index, int direction) const { return neighbor_[index * directions + direction]; }
+
+    /// on two or three faces, such a voxel is not a pixel of any screen
+    bool isEdge(int index) const { return edge_[index] != 0; }
+
+    static int axisOf(int direction) { return direction / 2; }
+    static int signOf(int direction) { return direction % 2 ? -1 : 1; }
+
+private:
+    SurfaceIndex();
+
+    static const int edge = VIRTUALCUBEMAXINDEX + 1;
+
+    std::vector<Vector3i> position_;
+    std::vector<int32_t> neighbor_;
+    std::vector<uint8_t> edge_;
+    /// dense lookup over the whole virtual cube, -1 inside
+    std::vector<int32_t> voxelToIndex_;
+};
+
+#endif //CUBECOMMON_SURFACEINDEX_H
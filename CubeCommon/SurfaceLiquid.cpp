@@ -0,0 +1,161 @@
+#include "SurfaceLiquid.h"
+#include <algorithm>
+#include <cmath>
+
+//steeper than this counts as downhill, flatter as sideways
+static const float slopeThreshold = 0.2f;
+
+SurfaceLiquid::SurfaceLiquid() : surface_(SurfaceIndex::instance()) {
+    const int n = surface_.size();
+    for (int axis = 0; axis < 3; axis++) {
+        order_[axis].resize(n);
+        for (int i = 0; i < n; i++)
+            order_[axis][i] = i;
+        std::stable_sort(order_[axis].begin(), order_[axis].end(),
+                         [&](int32_t a, int32_t b) { return surface_.position(a)[axis] < surface_.position(b)[axis]; });
+    }
+
+    full_.resize(n);
+    color_.resize(n);
+    age_.resize(n);
+    moved_.resize(n);
+    pourQueue_.reserve(n);
+    frame_ = 0;
+    lifetime_ = 0;
+    clear();
+}
+
+void SurfaceLiquid::lifetime(int steps) {
+    lifetime_ = steps;
+}
+
+void SurfaceLiquid::clear() {
+    std::fill(full_.begin(), full_.end(), 0);
+    std::fill(age_.begin(), age_.end(), 0);
+    std::fill(moved_.begin(), moved_.end(), 0);
+    filled_ = 0;
+}
+
+void SurfaceLiquid::pour(Vector3i point, int radius, Color col) {
+    int start = surface_.indexOf(point);
+    if (start < 0)
+        return;
+    //breadth first over the surface, moved_ doubles as visited mark for this frame
+    pourQueue_.clear();
+    pourQueue_.push_back(start);
+    moved_[start] = frame_ + 1;
+    for (int ring = 0, begin = 0; ring <= radius; ring++) {
+        int end = (int) pourQueue_.size();
+        for (int q = begin; q < end; q++) {
+            int i = pourQueue_[q];
+            if (!full_[i]) {
+                full_[i] = 1;
+                color_[i] = col;
+                age_[i] = 0;
+                filled_++;
+            }
+            if (ring == radius)
+                continue;
+            for (int d = 0; d < SurfaceIndex::directions; d++) {
+                int j = surface_.neighbor(i, d);
+                if (j >= 0 && moved_[j] != frame_ + 1) {
+                    moved_[j] = frame_ + 1;
+                    pourQueue_.push_back(j);
+                }
+            }
+        }
+        begin = end;
+    }
+    //stale marks only have to differ from the next step's frame number
+    for (int i : pourQueue_)
+        moved_[i] = 0;
+}
+
+void SurfaceLiquid::step(Vector3f gravity) {
+    frame_++;
+    float length = gravity.norm();
+    if (length < 1e-6f)
+        return;
+    gravity /= length;
+
+    //rank the six directions once per frame, uphill ones are never taken
+    int downhill[SurfaceIndex::directions], sideways[SurfaceIndex::directions];
+    int downhillCount = 0, sidewaysCount = 0;
+    int ranked[SurfaceIndex::directions] = {SurfaceIndex::plusX, SurfaceIndex::minusX, SurfaceIndex::plusY,
+                                           SurfaceIndex::minusY, SurfaceIndex::plusZ, SurfaceIndex::minusZ};
+    auto slope = [&](int d) { return gravity[SurfaceIndex::axisOf(d)] * SurfaceIndex::signOf(d); };
+    std::stable_sort(ranked, ranked + SurfaceIndex::directions, [&](int a, int b) { return slope(a) > slope(b); });
+    for (int d : ranked) {
+        if (slope(d) > slopeThreshold)
+            downhill[downhillCount++] = d;
+        else if (slope(d) >= -slopeThreshold)
+            sideways[sidewaysCount++] = d;
+    }
+
+    //walk the dominant gravity axis bottom first, so a column falls together instead of one cell per frame
+    int axis = 0;
+    for (int a = 1; a < 3; a++)
+        if (std::fabs(gravity[a]) > std::fabs(gravity[axis]))
+            axis = a;
+    const std::vector<int32_t> &order = order_[axis];
+    const int n = (int) order.size();
+    const bool reverse = gravity[axis] > 0;
+
+    for (int k = 0; k < n; k++) {
+        int i = order[reverse ? n - 1 - k : k];
+        if (!full_[i] || moved_[i] == frame_)
+            continue;
+        age_[i]++;
+        if (lifetime_ > 0 && age_[i] > lifetime_) {
+            full_[i] = 0;
+            filled_--;
+            continue;
+        }
+
+        int target = -1;
+        for (int c = 0; c < downhillCount && target < 0; c++) {
+            int j = surface_.neighbor(i, downhill[c]);
+            if (j >= 0 && !full_[j])
+                target = j;
+        }
+        //rotate the start so sideways flow has no preferred direction
+        for (int c = 0; c < sidewaysCount && target < 0; c++) {
+            int d = sideways[(c + i + frame_) % sidewaysCount];
+            int j = surface_.neighbor(i, d);
+            if (j >= 0 && !full_[j])
+                target = j;
+        }
+        if (target < 0)
+            continue;
+
+        full_[target] = 1;
+        color_[target] = color_[i];
+        age_[target] = age_[i];
+        moved_[target] = frame_;
+        full_[i] = 0;
+    }
+}
+
+void SurfaceLiquid::render(CubeApplication *ca) {
+    const int n = surface_.size();
+    for (int i = 0; i < n; i++) {
+        if (full_[i])
+            ca->setPixel3D(surface_.position(i), color_[i]);
+    }
+}
+
+void SurfaceLiquid::render(TrailBuffer &trail) {
+    const int n = surface_.size();
+    for (int i = 0; i < n; i++) {
+        if (full_[i])
+            trail.setPixel3D(surface_.position(i), color_[i]);
+    }
+}
+
+int SurfaceLiquid::cells() {
+    return surface_.size();
+}
+
+int SurfaceLiquid::filled() {
+    return filled_;
+}
@@ -0,0 +1,49 @@
+#ifndef CUBECOMMON_SURFACELIQUID_H
+#define CUBECOMMON_SURFACELIQUID_H
+
+#include "CubeApplication.h"
+#include "SurfaceIndex.h"
+#include "TrailBuffer.h"
+#include <vector>
+#include <cstdint>
+
+/// Falling sand style liquid with one cell per surface voxel of the virtual cube.
+/// Neighbors are the six axis steps that stay on the surface, so a face cell has 4 neighbors and
+/// liquid crosses an edge through the voxel both screens share without any special casing.
+/// Every step visits all cells once, the cost is the same for an empty and a full cube.
+class SurfaceLiquid {
+public:
+    SurfaceLiquid();
+
+    /// cells are emptied after this many steps, 0 keeps them forever
+    void lifetime(int steps);
+
+    /// fill the empty cells up to radius steps around point, point has to be on the surface
+    void pour(Vector3i point, int radius, Color col);
+    void clear();
+    /// move every filled cell one voxel along gravity, or sideways if that is blocked
+    void step(Vector3f gravity);
+    void render(CubeApplication *ca);
+    void render(TrailBuffer &trail);
+
+    int cells();
+    int filled();
+
+private:
+    /// cells are the surface voxels in SurfaceIndex order
+    const SurfaceIndex &surface_;
+    /// cells sorted by x, y and z, a step walks the one along gravity starting at the bottom
+    std::vector<int32_t> order_[3];
+
+    std::vector<uint8_t> full_;
+    std::vector<Color> color_;
+    std::vector<uint16_t> age_;
+    std::vector<uint32_t> moved_;
+    std::vector<int32_t> pourQueue_;
+
+    uint32_t frame_;
+    int filled_;
+    int lifetime_;
+};
+
+#endif //CUBECOMMON_SURFACELIQUID_H
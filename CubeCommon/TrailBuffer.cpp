@@ -0,0 +1,191 @@
+#include "TrailBuffer.h"
+#include <algorithm>
+
+static const int cubeEdge = VIRTUALCUBEMAXINDEX + 1;
+static const int screenSlots = cubeEdge * cubeEdge;
+
+TrailBuffer::TrailBuffer(float decay) {
+    color_.resize(6 * screenSlots);
+    activeIndex_.assign(6 * screenSlots, -1);
+    active_.reserve(6 * screenSlots);
+    splat_.resize(6 * screenSlots);
+    this->decay(decay);
+}
+
+void TrailBuffer::decay(float factor) {
+    //rounding down makes sure every channel reaches 0
+    for (int i = 0; i < 256; i++)
+        decay_[i] = (uint8_t) (i * factor);
+}
+
+int TrailBuffer::slotOf(const Vector3i &point) {
+    const int x = point[0], y = point[1], z = point[2];
+    if (x < 0 || y < 0 || z < 0 || x > VIRTUALCUBEMAXINDEX || y > VIRTUALCUBEMAXINDEX || z > VIRTUALCUBEMAXINDEX)
+        return -1;
+    if (x == 0 || x == VIRTUALCUBEMAXINDEX)
+        return (x == 0 ? 0 : 1) * screenSlots + y * cubeEdge + z;
+    if (y == 0 || y == VIRTUALCUBEMAXINDEX)
+        return (y == 0 ? 2 : 3) * screenSlots + x * cubeEdge + z;
+    if (z == 0 || z == VIRTUALCUBEMAXINDEX)
+        return (z == 0 ? 4 : 5) * screenSlots + x * cubeEdge + y;
+    return -1;
+}
+
+Vector3i TrailBuffer::pointOf(int slot) {
+    const int screen = slot / screenSlots;
+    const int u = slot % screenSlots / cubeEdge, v = slot % cubeEdge;
+    const int fixed = screen % 2 == 0 ? 0 : VIRTUALCUBEMAXINDEX;
+    switch (screen / 2) {
+        case 0:
+            return Vector3i(fixed, u, v);
+        case 1:
+            return Vector3i(u, fixed, v);
+        default:
+            return Vector3i(u, v, fixed);
+    }
+}
+
+void TrailBuffer::activate(int slot) {
+    if (activeIndex_[slot] < 0) {
+        activeIndex_[slot] = (int32_t) active_.size();
+        active_.push_back(slot);
+    }
+}
+
+void TrailBuffer::setPixel3D(const Vector3i &point, Color col) {
+    const int slot = slotOf(point);
+    if (slot < 0)
+        return;
+    color_[slot] = col;
+    activate(slot);
+}
+
+//the coordinate one voxel away from the edge at c
+static int inward(int c) {
+    return c == 0 ? 1 : VIRTUALCUBEMAXINDEX - 1;
+}
+
+static bool onBorder(int c) {
+    return c == 0 || c == VIRTUALCUBEMAXINDEX;
+}
+
+void TrailBuffer::addWeighted(Vector3i point, const Color &col, int weight, int fixed) {
+    if (weight == 0)
+        return;
+    const int u = (fixed + 1) % 3, v = (fixed + 2) % 3;
+    const bool onU = onBorder(point[u]), onV = onBorder(point[v]);
+    if (onU || onV)
+        point[fixed] = inward(point[fixed]);
+    if (onU && onV) {
+        //a cube corner, the two other screens get half each
+        Vector3i onScreenU = point, onScreenV = point;
+        onScreenU[v] = inward(point[v]);
+        onScreenV[u] = inward(point[u]);
+        addSplat(slotOf(onScreenU), col, weight / 2);
+        addSplat(slotOf(onScreenV), col, weight - weight / 2);
+        return;
+    }
+    addSplat(slotOf(point), col, weight);
+}
+
+void TrailBuffer::addSplat(int slot, const Color &col, int weight) {
+    if (slot < 0 || weight == 0)
+        return;
+    Color &dst = splat_[slot];
+    const bool wasBlack = dst.r() == 0 && dst.g() == 0 && dst.b() == 0;
+    dst.r((uint8_t) std::min(255, dst.r() + (col.r() * weight >> 8)));
+    dst.g((uint8_t) std::min(255, dst.g() + (col.g() * weight >> 8)));
+    dst.b((uint8_t) std::min(255, dst.b() + (col.b() * weight >> 8)));
+    if (wasBlack && (dst.r() != 0 || dst.g() != 0 || dst.b() != 0))
+        splatted_.push_back(slot);
+}
+
+void TrailBuffer::splat(const float *x, const float *y, const float *z, const Color *colors, int count,
+                        const uint8_t *visible) {
+    const float maxPos = VIRTUALCUBEMAXINDEX;
+    for (int i = 0; i < count; i++) {
+        if (visible != nullptr && !visible[i])
+            continue;
+        float p[3] = {std::max(0.0f, std::min(maxPos, x[i])),
+                      std::max(0.0f, std::min(maxPos, y[i])),
+                      std::max(0.0f, std::min(maxPos, z[i]))};
+
+        //the sample lies on the screen of the axis closest to 0 or VIRTUALCUBEMAXINDEX
+        int fixed = 0;
+        float closest = maxPos;
+        for (int axis = 0; axis < 3; axis++) {
+            float distance = std::min(p[axis], maxPos - p[axis]);
+            if (distance < closest) {
+                closest = distance;
+                fixed = axis;
+            }
+        }
+        const int u = (fixed + 1) % 3, v = (fixed + 2) % 3;
+        Vector3i corner;
+        corner[fixed] = p[fixed] < VIRTUALCUBECENTER ? 0 : VIRTUALCUBEMAXINDEX;
+        corner[u] = (int) p[u];
+        corner[v] = (int) p[v];
+        const int wu = (int) ((p[u] - corner[u]) * 256.0f);
+        const int wv = (int) ((p[v] - corner[v]) * 256.0f);
+
+        //corners on an edge hand their weight over to the neighbouring screen, samples keep their brightness
+        addWeighted(corner, colors[i], (256 - wu) * (256 - wv) >> 8, fixed);
+        corner[u]++;
+        addWeighted(corner, colors[i], wu * (256 - wv) >> 8, fixed);
+        corner[v]++;
+        addWeighted(corner, colors[i], wu * wv >> 8, fixed);
+        corner[u]--;
+        addWeighted(corner, colors[i], (256 - wu) * wv >> 8, fixed);
+    }
+
+    //the trail is only brightened, adding to the decayed color would saturate pixels hit every frame
+    for (int slot : splatted_) {
+        Color &dst = color_[slot];
+        Color &src = splat_[slot];
+        dst.r(std::max(dst.r(), src.r()));
+        dst.g(std::max(dst.g(), src.g()));
+        dst.b(std::max(dst.b(), src.b()));
+        src = Color::black();
+        activate(slot);
+    }
+    splatted_.clear();
+}
+
+void TrailBuffer::fade() {
+    for (int slot : active_) {
+        Color &col = color_[slot];
+        col.r(decay_[col.r()]);
+        col.g(decay_[col.g()]);
+        col.b(decay_[col.b()]);
+    }
+}
+
+void TrailBuffer::render(CubeApplication *ca) {
+    for (size_t i = 0; i < active_.size();) {
+        const int slot = active_[i];
+        const Color &col = color_[slot];
+        ca->setPixel3D(pointOf(slot), col);
+        if (col.r() == 0 && col.g() == 0 && col.b() == 0) {
+            //swap remove, the moved slot is written when the loop reaches index i again
+            const int last = active_.back();
+            active_[i] = last;
+            activeIndex_[last] = (int32_t) i;
+            active_.pop_back();
+            activeIndex_[slot] = -1;
+            continue;
+        }
+        i++;
+    }
+}
+
+void TrailBuffer::clear() {
+    for (int slot : active_) {
+        color_[slot] = Color::black();
+        activeIndex_[slot] = -1;
+    }
+    active_.clear();
+}
+
+int TrailBuffer::lit() {
+    return (int) active_.size();
+}
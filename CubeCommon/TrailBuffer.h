@@ -0,0 +1,55 @@
+#ifndef CUBECOMMON_TRAILBUFFER_H
+#define CUBECOMMON_TRAILBUFFER_H
+
+#include "CubeApplication.h"
+#include <vector>
+#include <cstdint>
+
+/// Replacement for fade() that only touches lit LEDs.
+/// Pixels drawn through the buffer are kept in a list, fade() decays that list with an integer
+/// table and render() writes it to the cube. A pixel is written once more when it reaches black and then
+/// forgotten, so the cost per frame follows the number of lit pixels instead of the cube size.
+/// Everything on the cube has to be drawn through the buffer, the LEDs are never cleared as a whole.
+class TrailBuffer {
+public:
+    TrailBuffer(float decay = 0.85f);
+
+    void decay(float factor);
+
+    /// same as CubeApplication::setPixel3D(), points inside the cube are ignored
+    void setPixel3D(const Vector3i &point, Color col);
+    /// anti-aliased drawing of count samples, every sample is spread bilinearly over the four nearest LEDs
+    /// of its screen, samples with visible[i] == 0 are skipped. The samples of one call add up with saturation,
+    /// a pixel keeps the brighter of that sum and its trail, so pixels hit every frame do not wash out to white
+    void splat(const float *x, const float *y, const float *z, const Color *colors, int count,
+               const uint8_t *visible = nullptr);
+    /// multiply every lit pixel by the decay factor
+    void fade();
+    /// write the lit pixels to the cube, pixels that turned black are written once and dropped
+    void render(CubeApplication *ca);
+    void clear();
+
+    /// pixels that are written by the next render()
+    int lit();
+
+private:
+    /// one slot per voxel and screen, edge voxels belong to the first screen in x, y, z order
+    static int slotOf(const Vector3i &point);
+    static Vector3i pointOf(int slot);
+    void activate(int slot);
+    /// add col * weight / 256 to the sum of the running splat(), point is on the screen of axis fixed.
+    /// Edge voxels are no LEDs, their weight goes to the pixel next to them on the neighbouring screen
+    void addWeighted(Vector3i point, const Color &col, int weight, int fixed);
+    void addSplat(int slot, const Color &col, int weight);
+
+    uint8_t decay_[256];
+    std::vector<Color> color_;
+    /// position of the slot in active_, -1 if it is dark
+    std::vector<int32_t> activeIndex_;
+    std::vector<int32_t> active_;
+    /// sum of the samples of the running splat() and the slots it touched
+    std::vector<Color> splat_;
+    std::vector<int32_t> splatted_;
+};
+
+#endif //CUBECOMMON_TRAILBUFFER_H
@@ -0,0 +1,86 @@
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cstdlib>
+
+WorkerPool::WorkerPool(int threads) {
+    job_ = nullptr;
+    count_ = 0;
+    chunkSize_ = 1;
+    nextChunk_ = 0;
+    busyWorkers_ = 0;
+    generation_ = 0;
+    stopping_ = false;
+    for (int i = 1; i < threads; i++)
+        workers_.emplace_back(&WorkerPool::workerMain, this);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+int WorkerPool::threads() {
+    return (int) workers_.size() + 1;
+}
+
+void WorkerPool::parallelFor(int count, int chunkSize, const std::function<void(int, int)> &job) {
+    if (workers_.empty() || count <= chunkSize) {
+        if (count > 0)
+            job(0, count);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &job;
+        count_ = count;
+        chunkSize_ = chunkSize;
+        nextChunk_ = 0;
+        busyWorkers_ = (int) workers_.size();
+        generation_++;
+    }
+    wake_.notify_all();
+    runChunks();
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busyWorkers_ == 0; });
+    job_ = nullptr;
+}
+
+int WorkerPool::defaultThreads() {
+    const char *env = getenv("CUBE_WORKER_THREADS");
+    if (env != nullptr && atoi(env) > 0)
+        return atoi(env);
+    return std::max(1, (int) std::thread::hardware_concurrency());
+}
+
+void WorkerPool::workerMain() {
+    unsigned long seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || generation_ != seenGeneration; });
+            if (stopping_)
+                return;
+            seenGeneration = generation_;
+        }
+        runChunks();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busyWorkers_--;
+        }
+        done_.notify_one();
+    }
+}
+
+void WorkerPool::runChunks() {
+    while (true) {
+        int begin = nextChunk_.fetch_add(1) * chunkSize_;
+        if (begin >= count_)
+            return;
+        (*job_)(begin, std::min(begin + chunkSize_, count_));
+    }
+}
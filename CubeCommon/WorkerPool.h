@@ -0,0 +1,44 @@
+#ifndef CUBECOMMON_WORKERPOOL_H
+#define CUBECOMMON_WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fixed set of worker threads for splitting per-frame work into chunks.
+/// The calling thread works on chunks as well, so a pool of n threads uses n-1 extra threads
+/// and a pool of one thread runs everything inline.
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads = defaultThreads());
+    ~WorkerPool();
+
+    int threads();
+
+    /// runs job(begin, end) for [0, count) split into chunks of chunkSize and returns when all chunks are done
+    void parallelFor(int count, int chunkSize, const std::function<void(int, int)> &job);
+
+    /// CUBE_WORKER_THREADS from the environment, otherwise the number of cores
+    static int defaultThreads();
+
+private:
+    void workerMain();
+    void runChunks();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(int, int)> *job_;
+    int count_;
+    int chunkSize_;
+    std::atomic<int> nextChunk_;
+    int busyWorkers_;
+    unsigned long generation_;
+    bool stopping_;
+};
+
+#endif //CUBECOMMON_WORKERPOOL_H
@@ -0,0 +1,44 @@
+# Runs every app headless for FRAMES frames with the same seed and scripted input and collects the
+# loop()/render() timings into one JSON file. Invoked by the bench target of the top level CMakeLists.txt:
+#   APPS      comma separated names, APP_<name> is the executable, ARGS_<name> its arguments
+#   FRAMES    frames per app
+#   SEED      CUBE_SEED of every app
+#   WORKDIR   directory for the per app results
+#   OUTPUT    combined JSON file
+
+string(REPLACE "," ";" APPS "${APPS}")
+get_filename_component(BENCHDIR ${CMAKE_CURRENT_LIST_FILE} DIRECTORY)
+file(MAKE_DIRECTORY ${WORKDIR})
+
+set(entries "")
+foreach (app ${APPS})
+    set(json ${WORKDIR}/${app}.json)
+    file(REMOVE ${json})
+    string(REPLACE "," ";" args "${ARGS_${app}}")
+    execute_process(
+            COMMAND ${CMAKE_COMMAND} -E env
+            CUBE_HEADLESS=${FRAMES}
+            CUBE_HEADLESS_JSON=${json}
+            CUBE_SEED=${SEED}
+            CUBE_JOYSTICK_SCRIPT=${BENCHDIR}/joystick.script
+            CUBE_IMU_REPLAY=${BENCHDIR}/imu.replay
+            ${APP_${app}} ${args}
+            WORKING_DIRECTORY ${WORKDIR}
+            RESULT_VARIABLE result
+            OUTPUT_FILE ${WORKDIR}/${app}.log
+            ERROR_FILE ${WORKDIR}/${app}.log
+            TIMEOUT 600)
+    if (result EQUAL 0 AND EXISTS ${json})
+        file(READ ${json} timing)
+        string(STRIP "${timing}" timing)
+        message(STATUS "${app}: ${timing}")
+    else ()
+        message(WARNING "${app} failed (${result}), see ${WORKDIR}/${app}.log")
+        set(timing "null")
+    endif ()
+    list(APPEND entries "    \"${app}\": ${timing}")
+endforeach ()
+
+string(REPLACE ";" ",\n" entries "${entries}")
+file(WRITE ${OUTPUT} "{\n  \"frames\": ${FRAMES},\n  \"seed\": ${SEED},\n  \"apps\": {\n${entries}\n  }\n}\n")
+message(STATUS "bench results written to ${OUTPUT}")
@@ -0,0 +1,82 @@
+# Runs every app headless with the bench seed and scripted input and compares the per frame hashes
+# with the goldens (MODE=check) or stores them as the new goldens (MODE=update).
+# Invoked by the golden-check and golden-update targets of the top level CMakeLists.txt:
+#   APPS      comma separated names, APP_<name> is the executable, ARGS_<name> its arguments
+#   FRAMES    frames per app
+#   SEED      CUBE_SEED of every app
+#   GOLDENDIR directory of the <name>.hashes goldens
+#   WORKDIR   directory for the hashes of this build, logs and the PNGs of the first differing frames
+
+string(REPLACE "," ";" APPS "${APPS}")
+get_filename_component(BENCHDIR ${CMAKE_CURRENT_LIST_FILE} DIRECTORY)
+file(MAKE_DIRECTORY ${WORKDIR})
+
+function(run_app app hashes pngframe)
+    string(REPLACE "," ";" args "${ARGS_${app}}")
+    execute_process(
+            COMMAND ${CMAKE_COMMAND} -E env
+            CUBE_HEADLESS=${FRAMES}
+            CUBE_HEADLESS_HASHES=${hashes}
+            CUBE_HEADLESS_PNG=${WORKDIR}/${app}-
+            CUBE_HEADLESS_PNG_FRAMES=${pngframe}
+            CUBE_SEED=${SEED}
+            CUBE_JOYSTICK_SCRIPT=${BENCHDIR}/joystick.script
+            CUBE_IMU_REPLAY=${BENCHDIR}/imu.replay
+            ${APP_${app}} ${args}
+            WORKING_DIRECTORY ${WORKDIR}
+            RESULT_VARIABLE result
+            OUTPUT_FILE ${WORKDIR}/${app}.log
+            ERROR_FILE ${WORKDIR}/${app}.log
+            TIMEOUT 600)
+    if (NOT result EQUAL 0 OR NOT EXISTS ${hashes})
+        message(SEND_ERROR "${app} failed (${result}), see ${WORKDIR}/${app}.log")
+    endif ()
+endfunction()
+
+set(failed "")
+foreach (app ${APPS})
+    set(hashes ${WORKDIR}/${app}.hashes)
+    set(golden ${GOLDENDIR}/${app}.hashes)
+    file(REMOVE ${hashes})
+    run_app(${app} ${hashes} "")
+    if (NOT EXISTS ${hashes})
+        list(APPEND failed ${app})
+    elseif (MODE STREQUAL "update")
+        file(MAKE_DIRECTORY ${GOLDENDIR})
+        configure_file(${hashes} ${golden} COPYONLY)
+        message(STATUS "${app}: golden updated")
+    elseif (NOT EXISTS ${golden})
+        message(WARNING "${app}: no golden in ${GOLDENDIR}, run the golden-update target on a reference build")
+        list(APPEND failed ${app})
+    else ()
+        file(STRINGS ${hashes} current)
+        file(STRINGS ${golden} expected)
+        if (current STREQUAL expected)
+            message(STATUS "${app}: ${FRAMES} frames match")
+        else ()
+            #find the first differing frame and dump it for review
+            list(LENGTH current count)
+            set(frame 0)
+            while (frame LESS count)
+                list(GET current ${frame} line)
+                list(LENGTH expected expectedCount)
+                if (frame LESS expectedCount)
+                    list(GET expected ${frame} expectedLine)
+                else ()
+                    set(expectedLine "")
+                endif ()
+                if (NOT line STREQUAL expectedLine)
+                    break()
+                endif ()
+                math(EXPR frame "${frame} + 1")
+            endwhile ()
+            run_app(${app} ${hashes} ${frame})
+            message(WARNING "${app}: frame ${frame} differs from the golden, see ${WORKDIR}/${app}-${frame}.png")
+            list(APPEND failed ${app})
+        endif ()
+    endif ()
+endforeach ()
+
+if (failed)
+    message(FATAL_ERROR "golden frames differ or missing: ${failed}")
+endif ()
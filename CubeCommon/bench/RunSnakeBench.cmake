@@ -0,0 +1,57 @@
+# Runs Snake headless with a growing number of AI snakes and worker threads and collects the loop()/render()
+# timings into one JSON file, frame time over snake count. Invoked by the snake-bench target of the top level
+# CMakeLists.txt:
+#   SNAKE     the Snake executable
+#   PLAYERS   comma separated CUBE_SNAKE_PLAYERS values
+#   THREADS   comma separated CUBE_WORKER_THREADS values
+#   FRAMES    frames per run
+#   SEED      CUBE_SEED of every run
+#   WORKDIR   directory for the per run results
+#   OUTPUT    combined JSON file
+
+string(REPLACE "," ";" PLAYERS "${PLAYERS}")
+string(REPLACE "," ";" THREADS "${THREADS}")
+# one core makes both default thread counts 1
+list(REMOVE_DUPLICATES THREADS)
+get_filename_component(BENCHDIR ${CMAKE_CURRENT_LIST_FILE} DIRECTORY)
+file(MAKE_DIRECTORY ${WORKDIR})
+
+set(entries "")
+foreach (players ${PLAYERS})
+    set(runs "")
+    foreach (threads ${THREADS})
+        set(run Snake-${players}-${threads})
+        set(json ${WORKDIR}/${run}.json)
+        file(REMOVE ${json})
+        execute_process(
+                COMMAND ${CMAKE_COMMAND} -E env
+                CUBE_HEADLESS=${FRAMES}
+                CUBE_HEADLESS_JSON=${json}
+                CUBE_SEED=${SEED}
+                CUBE_SNAKE_PLAYERS=${players}
+                CUBE_WORKER_THREADS=${threads}
+                CUBE_JOYSTICK_SCRIPT=${BENCHDIR}/joystick.script
+                CUBE_IMU_REPLAY=${BENCHDIR}/imu.replay
+                ${SNAKE}
+                WORKING_DIRECTORY ${WORKDIR}
+                RESULT_VARIABLE result
+                OUTPUT_FILE ${WORKDIR}/${run}.log
+                ERROR_FILE ${WORKDIR}/${run}.log
+                TIMEOUT 600)
+        if (result EQUAL 0 AND EXISTS ${json})
+            file(READ ${json} timing)
+            string(STRIP "${timing}" timing)
+            message(STATUS "${players} snakes, ${threads} threads: ${timing}")
+        else ()
+            message(WARNING "${run} failed (${result}), see ${WORKDIR}/${run}.log")
+            set(timing "null")
+        endif ()
+        list(APPEND runs "      \"${threads}\": ${timing}")
+    endforeach ()
+    string(REPLACE ";" ",\n" runs "${runs}")
+    list(APPEND entries "    \"${players}\": {\n${runs}\n    }")
+endforeach ()
+
+string(REPLACE ";" ",\n" entries "${entries}")
+file(WRITE ${OUTPUT} "{\n  \"frames\": ${FRAMES},\n  \"seed\": ${SEED},\n  \"snakes\": {\n${entries}\n  }\n}\n")
+message(STATUS "snake bench results written to ${OUTPUT}")
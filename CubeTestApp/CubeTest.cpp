@@ -1,4 +1,5 @@
 #include "CubeTest.h"
+#include "PhaseTimer.h"
 
 CubeTest::CubeTest() : CubeApplication(30){
 
@@ -22,7 +23,10 @@ bool CubeTest::loop() {
     drawText(ScreenNumber::bottom, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), Color::white(), "Screen 5 bottom");
     
 
-    render();
+    {
+        PHASE_TIMER("render");
+        render();
+    }
     loopcount++;
     return true;
 }
\ No newline at end of file
@@ -14,14 +14,13 @@ Genetic::Genetic() : MatrixApplication(40){
     // Allocate memory
     children_ = new citizen[popSize_];
     parents_ = new citizen[popSize_];
-    srand(time(NULL));
 
     // Set a random target_
-    target_ = rand() & 0xFFFFFF;
+    target_ = FastRandom::next() & 0xFFFFFF;
 
     // Create the first generation of random children_
     for (int i = 0; i < popSize_; ++i) {
-      children_[i].dna = rand() & 0xFFFFFF;
+      children_[i].dna = FastRandom::next() & 0xFFFFFF;
     }
 }
 
@@ -31,9 +30,7 @@ bool Genetic::loop(){
     swap();
     sort();
     mate();
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle (children_, children_ + popSize_, g);
+    std::shuffle (children_, children_ + popSize_, FastRandom::local());
 
     // Draw citizens to canvas
     for(int i=0; i < popSize_; i++) {
@@ -48,7 +45,7 @@ bool Genetic::loop(){
     // When we reach the 85% fitness threshold...
     if(is85PercentFit()) {
       // ...set a new random target_
-      target_ = rand() & 0xFFFFFF;
+      target_ = FastRandom::next() & 0xFFFFFF;
 
       // Randomly mutate everyone for sake of new colors
       for (int i = 0; i < popSize_; ++i) {
@@ -91,9 +88,9 @@ Genetic::~Genetic() {
     for (int i = numElite; i < popSize_; ++i) {
       //select the parents randomly
       const float sexuallyActive = 1.0 - eliteRate;
-      const int p1 = rand() % (int)(popSize_ * sexuallyActive);
-      const int p2 = rand() % (int)(popSize_ * sexuallyActive);
-      const unsigned matingMask = (~0u) << (rand() % bitsPerPixel);
+      const int p1 = FastRandom::below((int)(popSize_ * sexuallyActive));
+      const int p2 = FastRandom::below((int)(popSize_ * sexuallyActive));
+      const unsigned matingMask = (~0u) << FastRandom::below(bitsPerPixel);
 
       // Make a baby
       unsigned baby = (parents_[p1].dna & matingMask)
@@ -101,7 +98,7 @@ Genetic::~Genetic() {
       children_[i].dna = baby;
 
       // Mutate randomly based on mutation rate
-      if ((rand() / (float)RAND_MAX) < mutationRate) {
+      if (FastRandom::unit() < mutationRate) {
         mutate(children_[i]);
       }
     }
@@ -118,7 +115,7 @@ Genetic::~Genetic() {
 
   void Genetic::mutate(citizen& c) {
     // Flip a random bit
-    c.dna ^= 1 << (rand() % bitsPerPixel);
+    c.dna ^= 1 << FastRandom::below(bitsPerPixel);
   }
 
   /// can adjust this threshold to make transition to new target seamless
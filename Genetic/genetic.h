@@ -2,13 +2,14 @@
 #define __GENETIC_H__
 
 #include "MatrixApplication.h"
+#include "FastRandom.h"
 
 class Genetic : public MatrixApplication{
 public:
   Genetic();
   bool loop();
   ~Genetic();
-  static int rnd (int i) { return rand() % i; }
+  static int rnd (int i) { return FastRandom::below(i); }
 
 private:
   class citizen {
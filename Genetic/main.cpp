@@ -1,9 +1,12 @@
 #include "genetic.h"
+#include "HeadlessRunner.h"
 
 int main(int argc, char *argv[]) {
   Genetic App1;
-  App1.start();
+  if (!HeadlessRunner::runFromEnvironment(App1)) {
+    App1.start();
 
-  while(1) sleep(1);
+    while(1) sleep(1);
+  }
   return 0;
 }
@@ -1,15 +1,23 @@
 #include "ImuTest.h"
+#include "InputLog.h"
+#include "PhaseTimer.h"
 
 ImuTest::ImuTest() : CubeApplication(30){
-    Imu.init();
 }
 
 bool ImuTest::loop() {
     static int loopcount = 0;
-    std::cout << Imu.getAcceleration() << std::endl;
-    fade(0.85);
-    setPixel3D(Imu.getCubeAccIntersect(), Color::green());
-    render();
+    InputFrame::beginFrame();
+    ImuService::Sample imuSample = Imu.latest();
+    std::cout << imuSample.timestampUs << " gravity " << imuSample.acceleration.transpose() << " angular rate "
+              << imuSample.angularRate.transpose() << std::endl;
+    trail.fade();
+    trail.setPixel3D(imuSample.cubeAccIntersect, Color::green());
+    trail.render(this);
+    {
+        PHASE_TIMER("render");
+        render();
+    }
     loopcount++;
     return true;
 }
@@ -2,14 +2,16 @@
 #define MATRIXSERVER_CUBETEST_H
 
 #include <CubeApplication.h>
-#include <Mpu6050.h>
+#include "ImuService.h"
+#include "TrailBuffer.h"
 
 class ImuTest : public CubeApplication{
 public:
     ImuTest();
     bool loop();
 private:
-    Mpu6050 Imu;
+    ImuService Imu;
+    TrailBuffer trail;
 };
 
 #endif //MATRIXSERVER_CUBETEST_H
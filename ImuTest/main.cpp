@@ -1,10 +1,13 @@
 #include "ImuTest.h"
+#include "HeadlessRunner.h"
 
 
 int main(int argc, char *argv[]) {
     ImuTest App1;
-    App1.start();
+    if (!HeadlessRunner::runFromEnvironment(App1)) {
+        App1.start();
 
-    while(1) sleep(1);
+        while(1) sleep(1);
+    }
     return 0;
 }
@@ -1,4 +1,6 @@
 #include "picture.h"
+#include "InputLog.h"
+#include "PhaseTimer.h"
 #include <cmath>
 
 #include <iostream>
@@ -14,10 +16,10 @@ int animationPrescale = 0;
 
 
 Picture::Picture(int argc, char *argv[]) {
-    joysticks.push_back(new Joystick(0));
-    joysticks.push_back(new Joystick(1));
-    joysticks.push_back(new Joystick(2));
-    joysticks.push_back(new Joystick(3));
+    joysticks.push_back(JoystickInput::create(0));
+    joysticks.push_back(JoystickInput::create(1));
+    joysticks.push_back(JoystickInput::create(2));
+    joysticks.push_back(JoystickInput::create(3));
 
 //    for(int i = 0; i < argc; i++){
 //        std::cout << i << ": " << argv[i] << std::endl;
@@ -58,11 +60,15 @@ bool Picture::loadImage(std::string path) {
 bool Picture::loop() {
     static int loopcount = 0;
     static int verticalPos = 0;
+    InputFrame::beginFrame();
 
-    if (fs::last_write_time(fs::path(filepath)) > lastModificationTime) {
+    //no image is not an error, it may be plugged in later
+    std::error_code error;
+    fs::file_time_type modificationTime = fs::last_write_time(fs::path(filepath), error);
+    if (!error && modificationTime > lastModificationTime) {
         std::cout << "file change detected, reloading..." << std::endl;
         loadImage(filepath);
-        lastModificationTime = fs::last_write_time(fs::path(filepath));
+        lastModificationTime = modificationTime;
     }
 
     clear();
@@ -85,14 +91,19 @@ bool Picture::loop() {
         }
     }
 
-    drawImage(top, Vector2i(0, 0), autoload, Vector2i(0, verticalPos));
-    drawImage(left, Vector2i(0, 0), autoload, Vector2i(64, verticalPos));
-    drawImage(front, Vector2i(0, 0), autoload, Vector2i(128, verticalPos));
-    drawImage(right, Vector2i(0, 0), autoload, Vector2i(192, verticalPos));
-    drawImage(back, Vector2i(0, 0), autoload, Vector2i(256, verticalPos));
-    drawImage(bottom, Vector2i(0, 0), autoload, Vector2i(320, verticalPos));
+    if (autoload.getHeight() >= 64) {
+        drawImage(top, Vector2i(0, 0), autoload, Vector2i(0, verticalPos));
+        drawImage(left, Vector2i(0, 0), autoload, Vector2i(64, verticalPos));
+        drawImage(front, Vector2i(0, 0), autoload, Vector2i(128, verticalPos));
+        drawImage(right, Vector2i(0, 0), autoload, Vector2i(192, verticalPos));
+        drawImage(back, Vector2i(0, 0), autoload, Vector2i(256, verticalPos));
+        drawImage(bottom, Vector2i(0, 0), autoload, Vector2i(320, verticalPos));
+    }
 
     loopcount++;
-    render();
+    {
+        PHASE_TIMER("render");
+        render();
+    }
     return true;
 }
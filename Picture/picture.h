@@ -2,7 +2,7 @@
 #define PICTURE_H
 
 #include "CubeApplication.h"
-#include "Joystick.h"
+#include "JoystickInput.h"
 #include "Image.h"
 #include <vector>
 
@@ -16,7 +16,7 @@ private:
     bool loadImage(std::string filepath);
 
     Image autoload;
-    std::vector<Joystick *> joysticks;
+    std::vector<JoystickInput *> joysticks;
 };
 
 
@@ -1,9 +1,12 @@
 #include "pixelflow.h"
+#include "HeadlessRunner.h"
 
 int main(int argc, char *argv[]) {
-    PixelFlow App1;
-    App1.start();
+    PixelFlow App1(argc, argv);
+    if (!HeadlessRunner::runFromEnvironment(App1)) {
+        App1.start();
 
-    while(1) sleep(2);
+        while(1) sleep(2);
+    }
     return 0;
 }
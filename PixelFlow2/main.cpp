@@ -1,9 +1,12 @@
 #include "pixelflow2.h"
+#include "HeadlessRunner.h"
 
 int main(int argc, char *argv[]) {
     PixelFlow2 App1;
-    App1.start();
+    if (!HeadlessRunner::runFromEnvironment(App1)) {
+        App1.start();
 
-    while(1) sleep(2);
+        while(1) sleep(2);
+    }
     return 0;
 }
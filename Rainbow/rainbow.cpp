@@ -1,12 +1,13 @@
 #include "rainbow.h"
+#include "InputLog.h"
+#include "FastRandom.h"
+#include "PhaseTimer.h"
 #include <cmath>
 
 #include <iostream>
 #include <algorithm>
 #include <cctype>
-#include <memory>
 
-#define PI 3.14159265
 
 #define OVERSAMPLING 1
 
@@ -23,13 +24,17 @@ Color ColorFade(Color col1, Color col2, float progress) {
     return returnColor;
 }
 
-Rainbow::Rainbow() : CubeApplication(40) {
-    joysticks.push_back(new Joystick(0));
-    joysticks.push_back(new Joystick(1));
-    joysticks.push_back(new Joystick(2));
-    joysticks.push_back(new Joystick(3));
-
-    allTheColors.push_back(Color(255 - rand() % 100, 0, 0));
+Rainbow::Rainbow() : CubeApplication(FixedTimestep::displayRateFromEnvironment(40)), drops_(57344), spawner_(getFps(), 10, 50),
+        timestep_(FixedTimestep::tickRateFromEnvironment(40)) {
+    //same trail length in seconds as fade(0.85) at 40 fps
+    trail_.decay(std::pow(0.85f, 40.0f / getFps()));
+    drops_.workers(&workers_);
+    joysticks.push_back(JoystickInput::create(0));
+    joysticks.push_back(JoystickInput::create(1));
+    joysticks.push_back(JoystickInput::create(2));
+    joysticks.push_back(JoystickInput::create(3));
+
+    allTheColors.push_back(Color(255 - FastRandom::below(100), 0, 0));
     allTheColors.push_back(Color(255, 0, 0));
     allTheColors.push_back(Color(255, 255, 0));
     allTheColors.push_back(Color(0, 255, 0));
@@ -49,24 +54,25 @@ Rainbow::Rainbow() : CubeApplication(40) {
     allTheColorsRainbow.push_back(Color(255, 0, 255));
     //std::cout << "allTheColorsRainbow.size " << allTheColorsRainbow.size() << std::endl;
 
-    allTheColorsRandom.push_back(Color(rand()%127+127, 0, 0));
-    allTheColorsRandom.push_back(Color(0,rand()%127+127, 0));
-    allTheColorsRandom.push_back(Color(0,0,rand()%127+127));
-    allTheColorsRandom.push_back(Color(rand()%127+127, rand()%127+127, 0));
-    allTheColorsRandom.push_back(Color(0,rand()%127+127, rand()%127+127));
-    allTheColorsRandom.push_back(Color(rand()%127+127,0,rand()%127+127));
-    allTheColorsRandom.push_back(Color(rand()%127+127,rand()%127+127,rand()%127+127));
-    allTheColorsRandom.push_back(Color(rand()%255, 0, 0));
-    allTheColorsRandom.push_back(Color(0,rand()%255, 0));
-    allTheColorsRandom.push_back(Color(0,0,rand()%255));
-    allTheColorsRandom.push_back(Color(rand()%255, rand()%255, 0));
-    allTheColorsRandom.push_back(Color(0,rand()%255, rand()%255));
-    allTheColorsRandom.push_back(Color(rand()%255,0,rand()%255));
-    allTheColorsRandom.push_back(Color(rand()%255,rand()%255,rand()%255));
+    allTheColorsRandom.push_back(Color(FastRandom::below(127)+127, 0, 0));
+    allTheColorsRandom.push_back(Color(0,FastRandom::below(127)+127, 0));
+    allTheColorsRandom.push_back(Color(0,0,FastRandom::below(127)+127));
+    allTheColorsRandom.push_back(Color(FastRandom::below(127)+127, FastRandom::below(127)+127, 0));
+    allTheColorsRandom.push_back(Color(0,FastRandom::below(127)+127, FastRandom::below(127)+127));
+    allTheColorsRandom.push_back(Color(FastRandom::below(127)+127,0,FastRandom::below(127)+127));
+    allTheColorsRandom.push_back(Color(FastRandom::below(127)+127,FastRandom::below(127)+127,FastRandom::below(127)+127));
+    allTheColorsRandom.push_back(Color(FastRandom::below(255), 0, 0));
+    allTheColorsRandom.push_back(Color(0,FastRandom::below(255), 0));
+    allTheColorsRandom.push_back(Color(0,0,FastRandom::below(255)));
+    allTheColorsRandom.push_back(Color(FastRandom::below(255), FastRandom::below(255), 0));
+    allTheColorsRandom.push_back(Color(0,FastRandom::below(255), FastRandom::below(255)));
+    allTheColorsRandom.push_back(Color(FastRandom::below(255),0,FastRandom::below(255)));
+    allTheColorsRandom.push_back(Color(FastRandom::below(255),FastRandom::below(255),FastRandom::below(255)));
 }
 
 bool Rainbow::loop() {
-    static std::vector<std::shared_ptr<Drop>> rdrops;
+    InputFrame::beginFrame();
+    spawner_.frameStart();
     static int stepCounter = 0;
     static int counterColChange = 0;
     static Color col1(255, 0, 0);
@@ -110,8 +116,10 @@ bool Rainbow::loop() {
     static int counterPulseLong = 1000; //  in ms
     static int counterPulseLongStart = 0; //  in ms
     static bool trigerAxsis0 = 0; //  in ms
-    auto imuPoint = Imu.getAcceleration();
-    auto imuPointOld = Imu.getAcceleration();
+    ImuService::Sample imuSample = Imu.latest();
+    //kept across frames, so imuPointOld below is the reading of the frame before
+    static Vector3f imuPoint = imuSample.acceleration;
+    Vector3f imuPointOld = imuPoint;
 
 
 
@@ -120,8 +128,11 @@ bool Rainbow::loop() {
         isPaused = !isPaused;
         std::cout << "isPaused: " << isPaused << std::endl;
     }
-    if (isPaused)
+    if (isPaused) {
+        //no catching up on the paused time afterwards
+        timestep_.reset();
         return true;
+    }
 
     colorModeOld =colorMode;
     // Button Y -> Mode
@@ -239,11 +250,11 @@ bool Rainbow::loop() {
             if (colorChangeSpeedFactor <= 0.1f) {
                 counterPulse++;
             }
-            tempCounterPulseTime = counterPulseTime * ((float) ((rand() % 70)) / 100.0f + 0.7f);
+            tempCounterPulseTime = counterPulseTime * ((float)FastRandom::below(70) / 100.0f + 0.7f);
             if ((float)(counterPulse  / DEFAULTFPS) >=  tempCounterPulseTime)  {
                 std::cout << "Hallo" << std::endl;
                 colorChangeSpeedFactor = 0.4f;
-                colorChangeSpeedFactor *= (float) ((rand() % 70)) / 100.0f + 0.7f;
+                colorChangeSpeedFactor *= (float)FastRandom::below(70) / 100.0f + 0.7f;
                 counterPulse = 0;
             }
             if (colorChangeSpeedFactor > 0.1f) {
@@ -282,7 +293,7 @@ bool Rainbow::loop() {
                     col1 = Color::white();
                     break;
                 case 3:
-                    col1 = allTheColorsRandom.at(rand() % allTheColorsRandom.size());
+                    col1 = allTheColorsRandom.at(FastRandom::below(allTheColorsRandom.size()));
                     break;
                 default:
                     counterBackColorPulse = 0;
@@ -291,11 +302,11 @@ bool Rainbow::loop() {
 
             if (joysticks.at(0)->getButton(0)==1) {
                 colorChangeSpeedFactor = 0.4f;
-                colorChangeSpeedFactor *= (float) ((rand() % 100)) / 100.0f + 1.0f;
+                colorChangeSpeedFactor *= (float)FastRandom::below(100) / 100.0f + 1.0f;
 
                 //col1 = ColorFade(col1RainbowOld, col1RainbowNew, countRainbow);
-                //col1 = allTheColorsRainbow.at(rand() % 6);
-                col1 = allTheColorsRandom.at(rand() % allTheColorsRandom.size());
+                //col1 = allTheColorsRainbow.at(FastRandom::below(6));
+                col1 = allTheColorsRandom.at(FastRandom::below(allTheColorsRandom.size()));
             }
             break;
         case 4:
@@ -334,15 +345,15 @@ bool Rainbow::loop() {
             }
             imuPointOld = imuPoint;
             //std::cout << "imuPointOld: " << imuPointOld << std::endl;
-            imuPoint = Imu.getAcceleration();
+            imuPoint = imuSample.acceleration;
             std::cout << "imuPoint: " << imuPoint << std::endl;
 
             counterPulse3++;
             if (joysticks.at(0)->getButtonPress(0)==1 || imuPointOld != imuPoint) {
                 counterPulseLongStart = counterPulse3;
                 //col1 = ColorFade(col1RainbowOld, col1RainbowNew, countRainbow);
-                //col1 = allTheColorsRainbow.at(rand() % 6);
-                col1 = allTheColorsRandom.at(rand() % allTheColorsRandom.size());
+                //col1 = allTheColorsRainbow.at(FastRandom::below(6));
+                col1 = allTheColorsRandom.at(FastRandom::below(allTheColorsRandom.size()));
             }
 
             if ((counterPulse3-counterPulseLongStart)* 1000  / DEFAULTFPS >= counterPulseLong) {
@@ -377,187 +388,45 @@ bool Rainbow::loop() {
     }*/
 
 
-    col1 *= (float) ((rand() % 70)) / 100.0f + 0.7f;
+    col1 *= (float)FastRandom::below(70) / 100.0f + 0.7f;
 
-    fade(0.85);
-    //create new Raindrops
-    if(colorChangeSpeedFactor > 0.0f) {
-        for (int foo = 0; foo < 30; foo++) {
-            float randAngle = rand() % 360;
-            float vx = (colorChangeSpeedFactor / OVERSAMPLING) * cos(randAngle * PI / 180);
-            float vy = (colorChangeSpeedFactor / OVERSAMPLING) * sin(randAngle * PI / 180);
-            rdrops.push_back(
-                    std::make_shared<Drop>(Vector3i(VIRTUALCUBEMAXINDEX, VIRTUALCUBEMAXINDEX, VIRTUALCUBEMAXINDEX),
-                                           Vector3f(VIRTUALCUBECENTER, VIRTUALCUBECENTER, 0), Vector3f(vx, vy, 0),
-                                           Vector3f(0, 0, 0), col1));
+    trail_.fade();
+    for (int ticks = timestep_.advance(); ticks > 0; ticks--) {
+        //create new Raindrops
+        if (colorChangeSpeedFactor > 0.0f) {
+            for (int foo = 0; foo < spawner_.spawnRate(); foo++) {
+                const FastRandom::Direction &direction = FastRandom::randomDirection();
+                float vx = (colorChangeSpeedFactor / OVERSAMPLING) * direction.x;
+                float vy = (colorChangeSpeedFactor / OVERSAMPLING) * direction.y;
+                drops_.spawn(Vector3f(VIRTUALCUBECENTER, VIRTUALCUBECENTER, 0), Vector3f(vx, vy, 0), Vector3f(0, 0, 0), col1);
+            }
         }
+
+        for (int overSamplingCounter = 0; overSamplingCounter < OVERSAMPLING; overSamplingCounter++)
+            drops_.stepSpill(1.0f / OVERSAMPLING);
+
+        //remove drops from the bottom
+        drops_.recycleDead();
     }
+    drops_.renderInterpolated(trail_, timestep_.alpha());
 
 
 //    if (counter%50 == 0) {
 //        counterColChange++;
 //    }
 
+    if (stepCounter % (getFps() * 10) == 0)
+        std::cout << "drops: " << drops_.count() << " high water mark: " << drops_.highWaterMark() << "/"
+                  << drops_.capacity() << " dropped spawns: " << drops_.droppedSpawns()
+                  << " spawn rate: " << spawner_.spawnRate() << " frame time: " << spawner_.frameTime() << "ms" << std::endl;
 
-    for (auto r : rdrops) {
-        for (int overSamplingCounter = 0; overSamplingCounter < OVERSAMPLING; overSamplingCounter++) {
-            r->step();
-            setPixel3D(r->iPosition(), r->color());
-        }
+    trail_.render(this);
+    spawner_.frameEnd();
+    {
+        PHASE_TIMER("render");
+        render();
     }
-
-    //remove drops from the bottom
-    rdrops.erase(
-            std::remove_if(rdrops.begin(), rdrops.end(), [](std::shared_ptr<Drop> r) { return (r->getRdyDelete()); }),
-            rdrops.end());
-
-    render();
     stepCounter++;
 
     return true;
 }
-
-
-Rainbow::Drop::Drop(Vector3i maxPos, Vector3f pos, Vector3f vel, Vector3f accel, Color col)
-        : Particle(pos, vel, accel, col) {
-    maxPos_ = maxPos;
-    vxOld_ = 0.0f;
-    vyOld_ = 0.0f;
-    rdyDelete_ = false;
-}
-
-void Rainbow::Drop::step() {
-    static float oversamplingFactor = 1.0f / OVERSAMPLING;
-    Particle::step(); //Do the physics
-
-    if (position_[0] < 0 || position_[1] < 0 || position_[0] > maxPos_[0] || position_[1] > maxPos_[1]) {
-        velocity_[2] = 0.3f * oversamplingFactor;
-        acceleration_[2] = (0.02f + ((float) (rand() % 10) / 400.0f)) * oversamplingFactor;
-        acceleration_[1] = 0;
-        acceleration_[0] = 0;
-        if (vxOld_ == 0 && vyOld_ == 0) {
-            vxOld_ = velocity_[0];
-            vyOld_ = velocity_[1];
-        }
-        velocity_[0] = 0;
-        velocity_[1] = 0;
-    }
-
-    if (position_[0] < 0) {
-        position_[0] = 0;
-        position_[2] = 0;
-    }
-
-    if (position_[1] < 0) {
-        position_[1] = 0;
-        position_[2] = 0;
-    }
-
-    if (position_[0] > maxPos_[0]) {
-        position_[0] = maxPos_[0];
-        position_[2] = 0;
-    }
-
-    if (position_[1] > maxPos_[1]) {
-        position_[1] = maxPos_[1];
-        position_[2] = 0;
-    }
-
-    if (position_[2] < 0) {
-        position_[2] = 0;
-        velocity_[2] *= -1;
-    }
-
-    if (position_[2] > maxPos_[2]) {
-        position_[2] = maxPos_[2];
-        velocity_[0] = vxOld_ * -1;
-        velocity_[1] = vyOld_ * -1;
-        velocity_[2] = 0;
-        acceleration_[1] = 0;
-        acceleration_[0] = 0;
-        acceleration_[2] = 0;
-    }
-    if (((velocity_[0] > 0 && position_[0] > VIRTUALCUBECENTER) ||
-         (velocity_[0] < 0 && position_[0] < VIRTUALCUBECENTER)) && position_[2] == maxPos_[2]) {
-        velocity_[0] = 0;
-        vxOld_ = 0;
-    }
-    if (((velocity_[1] > 0 && position_[1] > VIRTUALCUBECENTER) ||
-         (velocity_[1] < 0 && position_[1] < VIRTUALCUBECENTER)) && position_[2] == maxPos_[2]) {
-        velocity_[1] = 0;
-        vyOld_ = 0;
-    }
-    if (velocity_[0] == 0 && velocity_[1] == 0 && position_[2] == maxPos_[2]) {
-        rdyDelete_ = true;
-    }
-
-}
-
-bool Rainbow::Drop::getRdyDelete() {
-    return rdyDelete_;
-}
-
-
-Rainbow::Particle::Particle(Vector3f pos, Vector3f vel, Vector3f accel, Color col)
-        : position_(pos),
-          velocity_(vel),
-          acceleration_(accel),
-          color_(col) {}
-
-void Rainbow::Particle::step() {
-    accelerate();
-    move();
-}
-
-void Rainbow::Particle::move() {
-    position_ += velocity_;
-}
-
-void Rainbow::Particle::accelerate() {
-    velocity_ += acceleration_;
-}
-
-Vector3f Rainbow::Particle::position() {
-    return position_;
-}
-
-Vector3f Rainbow::Particle::velocity() {
-    return velocity_;
-}
-
-Vector3f Rainbow::Particle::acceleration() {
-    return acceleration_;
-}
-
-Vector3i Rainbow::Particle::iPosition() {
-    return Vector3i(round(position()[0]), round(position()[1]), round(position()[2]));
-}
-
-Vector3i Rainbow::Particle::iVelocity() {
-    return Vector3i(round(velocity()[0]), round(velocity()[1]), round(position()[2]));
-}
-
-Vector3i Rainbow::Particle::iAcceleration() {
-    return Vector3i(round(acceleration()[0]), round(acceleration()[1]), round(acceleration()[2]));
-}
-
-void Rainbow::Particle::position(Vector3f pos) {
-    position_ = pos;
-}
-
-void Rainbow::Particle::velocity(Vector3f vel) {
-    velocity_ = vel;
-}
-
-void Rainbow::Particle::acceleration(Vector3f accel) {
-    acceleration_ = accel;
-}
-
-Color Rainbow::Particle::color() {
-    return color_;
-}
-
-void Rainbow::Particle::color(Color Col) {
-    color_ = Col;
-}
-
@@ -1,10 +1,13 @@
 //matrix app
 #include "snake.h"
+#include "HeadlessRunner.h"
 
 int main(int argc, char *argv[]) {
   Snake App1;
-  App1.start();
+  if (!HeadlessRunner::runFromEnvironment(App1)) {
+    App1.start();
 
-  while(1) sleep(2);
+    while(1) sleep(2);
+  }
   return 0;
 }
@@ -1,4 +1,8 @@
 #include "snake.h"
+#include "InputLog.h"
+#include "CubeTopology.h"
+#include "FastRandom.h"
+#include "PhaseTimer.h"
 //general
 #include <stdio.h>
 #include <algorithm>
@@ -8,35 +12,61 @@
 #include <iostream>
 #include <fstream>
 
-Snake::Snake() {
+//players up to this number get a joystick, the ones beyond are AI snakes
+static const int joystickPlayers = 8;
+
+//random turns use generator streams past the ones of the threads
+static const uint64_t kiRandomStream = 1u << 16;
+
+//unit velocity in the plane of the screen point is on
+static Vector3f alongScreen(const Vector3i &point) {
+    int normal = 0;
+    for (int i = 0; i < 3; i++)
+        if (point[i] == 0 || point[i] == VIRTUALCUBEMAXINDEX)
+            normal = i;
+    Vector3f velocity(0, 0, 0);
+    velocity[(normal + 2) % 3] = 1;
+    return velocity;
+}
+
+//the ticks are the former 8 substeps per frame at 40 fps, the velocities are in cells per tick
+Snake::Snake() : CubeApplication(FixedTimestep::displayRateFromEnvironment(40)),
+                 highScores(DEFAULTHIGHSCOREFILE),
+                 timestep(FixedTimestep::tickRateFromEnvironment(8 * 40), 32) {
     float startSpeed = 0.1;
-    players.push_back(new Player(this, 0, getRandomPointOnScreen(top).cast<float>(), Vector3f(0, startSpeed, 0), Color::green(), 10));
-    players.push_back(new Player(this, 1, getRandomPointOnScreen(top).cast<float>(), Vector3f(0, startSpeed, 0), Color::green() + Color::red(), 10));
-    players.push_back(new Player(this, 2, getRandomPointOnScreen(top).cast<float>(), Vector3f(0, startSpeed, 0), Color::blue() + Color::red(), 10));
-    players.push_back(new Player(this, 3, getRandomPointOnScreen(top).cast<float>(), Vector3f(0, startSpeed, 0), Color::red(), 10));
-    players.push_back(new Player(this, 4, getRandomPointOnScreen(top).cast<float>(), Vector3f(0, startSpeed, 0), Color::blue()*0.5, 10));
-    players.push_back(new Player(this, 5, getRandomPointOnScreen(top).cast<float>(), Vector3f(0, startSpeed, 0), Color::blue() + Color::red()*0.3, 10));
-    players.push_back(new Player(this, 6, getRandomPointOnScreen(top).cast<float>(), Vector3f(0, startSpeed, 0), Color::green()*0.4+Color::blue()*0.2, 10));
-    players.push_back(new Player(this, 7, getRandomPointOnScreen(top).cast<float>(), Vector3f(0, startSpeed, 0), Color::white()*0.6, 10));
-//  for(int i = 4; i < 20; i++)
-//      players.push_back(new Player(this, i, getRandomPointOnScreen(anyScreen).cast<float>(), Vector3f(0, startSpeed, 0), Color::random(), 10));
+    highScoreTime = false;
+    highScoreColor = Color::white();
+    freeCells = new FreeCells();
+    grid = new Grid(freeCells);
+    foodAt.assign(SurfaceIndex::instance().size(), -1);
+    const Color colors[joystickPlayers] = {Color::green(), Color::green() + Color::red(), Color::blue() + Color::red(),
+                                           Color::red(), Color::blue() * 0.5, Color::blue() + Color::red() * 0.3,
+                                           Color::green() * 0.4 + Color::blue() * 0.2, Color::white() * 0.6};
+    const char *count = getenv("CUBE_SNAKE_PLAYERS");
+    int playerCount = std::max(count != nullptr ? atoi(count) : joystickPlayers, 1);
+    for (int i = 0; i < playerCount; i++) {
+        if (i < joystickPlayers) {
+            players.push_back(new Player(this, i, getRandomPointOnScreen(top).cast<float>(), Vector3f(0, startSpeed, 0), colors[i], 10));
+        } else {
+            //the AI snakes beyond the joysticks start all over the cube
+            Vector3i start = getRandomPointOnScreen((ScreenNumber) (i % 6));
+            players.push_back(new Player(this, i, start.cast<float>(), alongScreen(start) * startSpeed, Color::random(), 10));
+        }
+    }
     for (int i = 0; i < 20; i++) {
-        food.push_back(new Food(this, getRandomPointOnScreen(front), Color::randomBlue() * 2));
-        food.push_back(new Food(this, getRandomPointOnScreen(right), Color::randomBlue() * 2));
-        food.push_back(new Food(this, getRandomPointOnScreen(back), Color::randomBlue() * 2));
-        food.push_back(new Food(this, getRandomPointOnScreen(left), Color::randomBlue() * 2));
-        food.push_back(new Food(this, getRandomPointOnScreen(top), Color::randomBlue() * 2));
-        food.push_back(new Food(this, getRandomPointOnScreen(bottom), Color::randomBlue() * 2));
+        spawnFood(front);
+        spawnFood(right);
+        spawnFood(back);
+        spawnFood(left);
+        spawnFood(top);
+        spawnFood(bottom);
     }
-    currentHighScore = 0;
-    updateHighScoreFromToFile();
 }
 
 bool Snake::loop() {
     static long loopcount = 0;
-    static bool highScoreTime = false;
     static int highScoreTimer = 120;
-    static Color highScoreColor = Color::white();
+    InputFrame::beginFrame();
 
     clear();
 
@@ -49,12 +79,12 @@ bool Snake::loop() {
         else
             fontColor = highScoreColor;
 
-        drawText(top, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(currentHighScore));
-        drawText(left, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(currentHighScore));
-        drawText(front, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(currentHighScore));
-        drawText(right, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(currentHighScore));
-        drawText(back, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(currentHighScore));
-        drawText(bottom, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(currentHighScore));
+        drawText(top, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(highScores.best()));
+        drawText(left, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(highScores.best()));
+        drawText(front, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(highScores.best()));
+        drawText(right, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(highScores.best()));
+        drawText(back, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(highScores.best()));
+        drawText(bottom, Vector2i(CharacterBitmaps::centered, CharacterBitmaps::centered), fontColor, "HIGHSCORE " + std::to_string(highScores.best()));
 
         highScoreTimer--;
         if (highScoreTimer == 0) {
@@ -64,86 +94,124 @@ bool Snake::loop() {
     }
 
 
-    //normal gameplay
-    for (int oversampling = 8; oversampling > 0; oversampling--) {
+    //normal gameplay, every snake moves the distance of all ticks of the frame at once
+    int ticks = timestep.advance();
+    if (ticks > 0) {
+        PHASE_TIMER("step");
         for (auto player : players) {
+            player->newFrame();
             player->handleJoystick();
-            player->step();
-            for (auto player2 : players) {
-                if (player->collidesWith(player2->iPosition()) && player != player2 && !player->getIsDying() &&
-                    !player2->getIsDying()) {
-                    player2->die();
-                    player->grow(player2->getSnakeLength() / 4);
-                    player->speedUp(1.10);
-                    if (updateHighScoreFromToFile(player2->getSnakeLength())) {
-                        highScoreTime = true;
-                        highScoreColor = player2->getDefaultColor();
-                    }
-                }
-            }
+        }
+        //the snakes move and plan in parallel on the grid of the frame start, the grid changes in commitCrossings()
+        workers.parallelFor((int) players.size(), 1, [this, ticks](int begin, int end) {
+            for (int i = begin; i < end; i++)
+                players[i]->step(ticks);
+        });
+        commitCrossings();
+        for (auto player : players) {
             if (player->getIsDead())
                 player->reset();
-            player->render();
-        }
-
-        for (auto f : food) {
-            for (auto p : players) {
-                if (p->iPosition() == f->getPosition()) {
-                    p->grow(2);
-                    p->speedUp(1.05);
-                    f->eat();
-                    food.push_back(new Food(this, getRandomPointOnScreen(anyScreen), Color::randomBlue() * 2));
-                }
-            }
-            f->render();
         }
-        food.erase(std::remove_if(food.begin(), food.end(), [](Food *f) { return (f->getIsEaten()); }), food.end());
     }
 
-    drawText(top, Vector2i(CharacterBitmaps::right, 58), highScoreColor * 0.5, std::to_string(currentHighScore));
+    //drawn once per frame, a frame can have no tick when the display runs faster than the simulation
+    {
+        PHASE_TIMER("draw");
+        for (auto player : players)
+            player->render();
+        for (auto &f : food)
+            f.render();
+
+        drawText(top, Vector2i(CharacterBitmaps::right, 58), highScoreColor * 0.5, std::to_string(highScores.best()));
+    }
 
-    render();
+    {
+        PHASE_TIMER("render");
+        render();
+    }
     loopcount++;
     return true;
 }
 
 
-bool Snake::updateHighScoreFromToFile(int score, std::string filename) {
-    bool returnValue = false;
-    std::ifstream configFileReadStream(filename);
-
-    std::fstream highScoreFile;
-    highScoreFile.open(filename.data(), std::fstream::binary | std::fstream::in);
-    if (highScoreFile) {
-        highScoreFile >> currentHighScore;
-        std::cout << "file open successful, highscore: " << currentHighScore << std::endl;
-    } else {
-        //create file
-        highScoreFile.open(filename.data(),
-                           std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-        highScoreFile << 0;
-        std::cout << "file created successful" << std::endl;
+bool Snake::headEntered(Player *player, int cell) {
+    int other = grid->other(cell, player->getId());
+    if (other >= 0 && !players[other]->getIsDying()) {
+        //the snake that runs into another one dies, into its body or its head alike
+        Player *winner = players[other];
+        player->die();
+        winner->grow(player->getSnakeLength() / 4);
+        winner->speedUp(1.10);
+        if (highScores.submit(player->getSnakeLength())) {
+            highScoreTime = true;
+            highScoreColor = player->getDefaultColor();
+        }
+        return false;
     }
+    if (foodAt[cell] >= 0) {
+        player->grow(2);
+        player->speedUp(1.05);
+        eatFood(cell);
+        spawnFood();
+    }
+    return true;
+}
 
-    if (score > currentHighScore) {
-        std::cout << "NEW HIGHSCORE: " << score << std::endl;
-        currentHighScore = score;
-        returnValue = true;
+void Snake::commitCrossings() {
+    crossings.clear();
+    for (auto player : players)
+        crossings.insert(crossings.end(), player->getCrossed().begin(), player->getCrossed().end());
+    //the order does not depend on the threads: of two heads entering a cell at the same time the one of the lower
+    //id is first and eats the food there, the higher id runs into its head and dies
+    std::stable_sort(crossings.begin(), crossings.end(), [](const Crossing &a, const Crossing &b) {
+        return a.time < b.time || (a.time == b.time && a.player < b.player);
+    });
+    for (const Crossing &crossing : crossings) {
+        Player *player = players[crossing.player];
+        //a snake that died this frame enters no more cells
+        if (!player->getIsDying())
+            player->enterCell(crossing.cell);
+    }
+}
 
-        highScoreFile.close();
-        highScoreFile.open(filename.data(),
-                           std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-        highScoreFile << currentHighScore;
+void Snake::spawnFood(ScreenNumber screen) {
+    int cell = -1;
+    if (screen == anyScreen) {
+        cell = freeCells->sample();
+    } else {
+        //a few tries on the screen, it is never close to full
+        for (int tries = 0; tries < 64 && cell < 0; tries++) {
+            cell = SurfaceIndex::instance().indexOf(getRandomPointOnScreen(screen));
+            if (cell >= 0 && !freeCells->isFree(cell))
+                cell = -1;
+        }
     }
+    if (cell < 0)
+        return;
+    freeCells->block(cell);
+    foodAt[cell] = (int32_t) food.size();
+    food.emplace_back(this, SurfaceIndex::instance().position(cell), Color::randomBlue() * 2);
+}
 
-    highScoreFile.close();
-    return returnValue;
+void Snake::eatFood(int cell) {
+    //the last pellet fills the gap
+    int32_t index = foodAt[cell];
+    int last = SurfaceIndex::instance().indexOf(food.back().getPosition());
+    food[index] = food.back();
+    foodAt[last] = index;
+    food.pop_back();
+    foodAt[cell] = -1;
+    freeCells->unblock(cell);
 }
 
-Snake::Player::Player(CubeApplication *renderCube, int joysticknumber, Vector3f setPosition, Vector3f setVelocity,
-                      Color setColor, unsigned int length) : joystick(joysticknumber) {
-    ca = renderCube;
-    tail.push_back(position);
+Snake::Player::Player(Snake *setGame, int joysticknumber, Vector3f setPosition, Vector3f setVelocity, Color setColor,
+                      unsigned int length)
+        : joystick(joysticknumber < joystickPlayers ? JoystickInput::create(joysticknumber) : nullptr),
+          kiRandom(FastRandom::currentSeed(), kiRandomStream + joysticknumber) {
+    ca = setGame;
+    game = setGame;
+    grid = game->grid;
+    id = joysticknumber;
     position = setPosition;
     velocity = setVelocity;
     acceleration = Vector3f(0, 0, 0);
@@ -155,6 +223,13 @@ Snake::Player::Player(CubeApplication *renderCube, int joysticknumber, Vector3f
     defaultColor = color;
     isDying = false;
     isDead = false;
+    const char *budget = getenv("CUBE_SNAKE_KI_BUDGET");
+    kiBudget = budget != nullptr ? std::max(atoi(budget), 0) : 4096;
+    kiBudgetLeft = kiBudget;
+    kiPathStep = 0;
+    tail.reserve(snakeLength + 1);
+    tail.push(cellOf(position));
+    grid->add(tail.back(), id);
 }
 
 
@@ -165,58 +240,105 @@ void Snake::Player::reset() {
     snakeLength = defaultSnakeLength;
     isDying = false;
     isDead = false;
+    for (unsigned int i = 0; i < tail.size(); i++)
+        grid->remove(tail[i], id);
     tail.clear();
 }
 
 
-void Snake::Player::step() {
+void Snake::Player::step(int ticks) {
+    crossed.clear();
     if (!isDying) {
-        accelerate();
-        move();
-        warp();
-
-        for (unsigned int i = 0; i < 3; i++) {
-            if (position[i] < 0.01 && position[i] > 0)
-                position[i] = 0;
-            if (position[i] > VIRTUALCUBEMAXINDEX - 0.01)
-                position[i] = VIRTUALCUBEMAXINDEX;
+        if (isKi())
+            doKiMove(frameHead());
+        accelerate(ticks);
+        //the first step after a reset puts the head on the grid
+        cross(0);
+
+        //move to just past the next cell border, until the ticks are used up
+        float remaining = (float) ticks;
+        while (remaining > 0) {
+            float speed = velocity.norm();
+            if (speed <= 0)
+                break;
+            int axis = 0;
+            velocity.cwiseAbs().maxCoeff(&axis);
+            float sign = velocity[axis] > 0 ? 1.0f : -1.0f;
+            float border = std::round(position[axis]) + 0.5f * sign;
+            float ticksToBorder = (border - position[axis]) * sign / speed;
+            if (ticksToBorder >= remaining) {
+                move(remaining);
+                break;
+            }
+            position[axis] = border + 0.001f * sign;
+            remaining -= ticksToBorder;
+            warp();
+
+            for (unsigned int i = 0; i < 3; i++) {
+                if (position[i] < 0.01 && position[i] > 0)
+                    position[i] = 0;
+                if (position[i] > VIRTUALCUBEMAXINDEX - 0.01)
+                    position[i] = VIRTUALCUBEMAXINDEX;
+            }
+            cross((float) ticks - remaining);
         }
-
-        //append to tail
-        if (iPosition() != tail.back().cast<int>())
-            tail.push_back(iPosition().cast<float>());
-
-        //Check collisions
-        Vector3i head = iPosition();
-        int colCounter = 0;
-        for (auto t : tail)
-            if (head == t.cast<int>())
-                colCounter++;
-        if (colCounter > 1)
-            die();
-
-        //cap the tailssize
-        if (tail.size() > snakeLength)
-            tail.erase(tail.begin(), tail.end() - snakeLength);
     } else {
+        dieCounter += ticks;
         if (dieCounter / 40 % 2) {
             color = Color::black();
         } else {
             color = Color::white();
         }
-        dieCounter++;
         if (dieCounter >= 200) {
             isDead = true;
         }
     }
 }
 
-void Snake::Player::accelerate() {
-    velocity += acceleration;
+void Snake::Player::cross(float time) {
+    int cell = SurfaceIndex::instance().indexOf(iPosition());
+    if (cell == frameHead())
+        return;
+    crossed.push_back(Crossing{time, (int16_t) id, (uint16_t) cell});
+    //the path is followed cell by cell, random turns are decided once per frame
+    if (isKi() && kiBudget > 0)
+        doKiMove(cell);
 }
 
-void Snake::Player::move() {
-    position += velocity;
+int Snake::Player::frameHead() {
+    return crossed.empty() ? headCell() : crossed.back().cell;
+}
+
+const std::vector<Snake::Crossing> &Snake::Player::getCrossed() {
+    return crossed;
+}
+
+void Snake::Player::enterCell(int cell) {
+    //append to tail
+    tail.push(cell);
+    grid->add(cell, id);
+
+    //Check collisions, the head is on the grid already
+    if (grid->count(cell, id) > 1) {
+        die();
+        return;
+    }
+
+    //cap the tailssize
+    while (tail.size() > snakeLength) {
+        grid->remove(tail.front(), id);
+        tail.pop();
+    }
+
+    game->headEntered(this, cell);
+}
+
+void Snake::Player::accelerate(int ticks) {
+    velocity += acceleration * (float) ticks;
+}
+
+void Snake::Player::move(float ticks) {
+    position += velocity * ticks;
 }
 
 void Snake::Player::warp() {
@@ -225,33 +347,12 @@ void Snake::Player::warp() {
         position[i] = constrain(position[i], 0.0f, (float) VIRTUALCUBEMAXINDEX);
 
     Vector3i currentPosition = iPosition();
-    EdgeNumber currentEdge = ca->getEdgeNumber(currentPosition);
+    const CubeTopology::Cell &currentCell = CubeTopology::classify(currentPosition);
+    EdgeNumber currentEdge = currentCell.edge();
 
     if (currentEdge != anyEdge) {
         if (currentEdge != lastEdge) {
-            switch (currentEdge) {
-                case topLeft:
-                case topRight:
-                case bottomRight:
-                case bottomLeft:
-                    std::swap(velocity[2], velocity[0]);
-                    break;
-                case topFront:
-                case topBack:
-                case bottomBack:
-                case bottomFront:
-                    std::swap(velocity[2], velocity[1]);
-                    break;
-                case frontRight:
-                case backLeft:
-                case leftFront:
-                case rightBack:
-                    std::swap(velocity[0], velocity[1]);
-                    break;
-                case anyEdge:
-                default:
-                    break;
-            }
+            CubeTopology::applySwap(currentCell.swap(), velocity);
             //set position to the rounded position to eliminate being always slightly below the surface due to rounding errors
             position = currentPosition.cast<float>();
             //constrain velocity directions, reflect if neccessary
@@ -271,93 +372,185 @@ void Snake::Player::warp() {
 }
 
 void Snake::Player::handleJoystick() {
-    if (joystick.isFound()) {
-        float newAxis0 = joystick.getAxis(0);
+    if (!isKi()) {
+        float newAxis0 = joystick->getAxis(0);
         if (newAxis0 < 0 && lastAxis0 == 0) {
             turnLeft();
         } else if (newAxis0 > 0 && lastAxis0 == 0) {
             turnRight();
         }
         lastAxis0 = newAxis0;
+    }
+}
+
+bool Snake::Player::isKi() {
+    return joystick == nullptr || !joystick->isFound();
+}
+
+void Snake::Player::doKiMove(int head) {
+    if (kiBudget == 0) {
+        //the former 2 in 512 per tick, at 8 ticks per frame
+        int random = kiRandom.below(512);
+        if (random < 8) {
+            turnLeft();
+        } else if (random < 16) {
+            turnRight();
+        }
+        return;
+    }
+    if (isDying || head < 0)
+        return;
+    const SurfaceIndex &surface = SurfaceIndex::instance();
+
+    const std::vector<int32_t> &foodAt = game->foodAt;
+    bool onPath = followPath(head);
+    if (!onPath && !planner.isSearching())
+        planner.start(head, directionOf(velocity) ^ 1);
+    if (planner.isSearching() && kiBudgetLeft > 0) {
+        if (planner.search(grid, foodAt, kiBudgetLeft)) {
+            kiPathStep = 0;
+            onPath = followPath(head);
+        }
+    }
+
+    int direction = -1;
+    if (onPath) {
+        Vector3i step = surface.position(planner.path()[kiPathStep + 1]) - surface.position(head);
+        for (int d = 0; d < SurfaceIndex::directions; d++)
+            if (step[SurfaceIndex::axisOf(d)] == SurfaceIndex::signOf(d))
+                direction = d;
     } else {
-        doKiMove();
+        //no path yet, head for the free cell with the most free neighbors, straight ahead on a tie
+        Vector3f ways[3] = {velocity, turnedLeft(), turnedRight()};
+        int bestFree = 0;
+        for (const Vector3f &way : ways) {
+            int next = surface.neighbor(head, directionOf(way));
+            if (next < 0 || grid->owner(next) >= 0)
+                continue;
+            int free = 1;
+            for (int d = 0; d < SurfaceIndex::directions; d++) {
+                int after = surface.neighbor(next, d);
+                if (after >= 0 && grid->owner(after) < 0)
+                    free++;
+            }
+            if (free > bestFree) {
+                bestFree = free;
+                direction = directionOf(way);
+            }
+        }
     }
+    if (direction >= 0)
+        steer(direction);
+}
+
+bool Snake::Player::followPath(int head) {
+    const std::vector<uint16_t> &path = planner.path();
+    if (kiPathStep + 1 < path.size() && path[kiPathStep + 1] == head)
+        kiPathStep++;
+    return kiPathStep + 1 < path.size() && path[kiPathStep] == head && grid->owner(path[kiPathStep + 1]) < 0 &&
+           game->foodAt[path.back()] >= 0;
+}
+
+int Snake::Player::directionOf(const Vector3f &velocity) {
+    int axis = 0;
+    velocity.cwiseAbs().maxCoeff(&axis);
+    return 2 * axis + (velocity[axis] < 0);
+}
+
+void Snake::Player::newFrame() {
+    kiBudgetLeft = kiBudget;
 }
 
-void Snake::Player::doKiMove() {
-    int random = rand() % 512;
-    if (random == 55) {
+void Snake::Player::steer(int direction) {
+    //an edge is crossed straight, there is nothing to turn on it
+    if (isDying || ca->isOnEdge(iPosition()))
+        return;
+    //a snake can not reverse, its neck is right behind the head
+    if (directionOf(velocity) == direction || (directionOf(velocity) ^ 1) == direction)
+        return;
+    if (directionOf(turnedLeft()) == direction)
         turnLeft();
-    } else if (random == 66) {
+    else
         turnRight();
-    }
+    //turn in the center of the head cell, the cells the head visits are the ones of the path
+    position = iPosition().cast<float>();
 }
 
 void Snake::Player::render() {
-    for (auto t : tail) {
-        ca->setPixel3D(t[0], t[1], t[2], color);
+    const SurfaceIndex &surface = SurfaceIndex::instance();
+    for (unsigned int i = 0; i < tail.size(); i++) {
+        ca->setPixel3D(surface.position(tail[i]), color);
     }
 }
 
 void Snake::Player::turnLeft() {
-    if (!isDying && !ca->isOnEdge(iPosition())) {
-        if (position[2] == 0) {
-            std::swap(velocity[0], velocity[1]);
-            velocity[0] = -velocity[0];
-        } else if (position[2] == VIRTUALCUBEMAXINDEX) {
-            std::swap(velocity[0], velocity[1]);
-            velocity[1] = -velocity[1];
-        } else if (position[1] == 0) {
-            std::swap(velocity[0], velocity[2]);
-            velocity[2] = -velocity[2];
-        } else if (position[1] == VIRTUALCUBEMAXINDEX) {
-            std::swap(velocity[0], velocity[2]);
-            velocity[0] = -velocity[0];
-        } else if (position[0] == 0) {
-            std::swap(velocity[1], velocity[2]);
-            velocity[1] = -velocity[1];
-        } else if (position[0] == VIRTUALCUBEMAXINDEX) {
-            std::swap(velocity[1], velocity[2]);
-            velocity[2] = -velocity[2];
-        } else {
-            std::cout << position << std::endl;
-        }
+    if (!isDying && !ca->isOnEdge(iPosition()))
+        velocity = turnedLeft();
+}
+
+Vector3f Snake::Player::turnedLeft() {
+    Vector3f turned = velocity;
+    if (position[2] == 0) {
+        std::swap(turned[0], turned[1]);
+        turned[0] = -turned[0];
+    } else if (position[2] == VIRTUALCUBEMAXINDEX) {
+        std::swap(turned[0], turned[1]);
+        turned[1] = -turned[1];
+    } else if (position[1] == 0) {
+        std::swap(turned[0], turned[2]);
+        turned[2] = -turned[2];
+    } else if (position[1] == VIRTUALCUBEMAXINDEX) {
+        std::swap(turned[0], turned[2]);
+        turned[0] = -turned[0];
+    } else if (position[0] == 0) {
+        std::swap(turned[1], turned[2]);
+        turned[1] = -turned[1];
+    } else if (position[0] == VIRTUALCUBEMAXINDEX) {
+        std::swap(turned[1], turned[2]);
+        turned[2] = -turned[2];
+    } else {
+        std::cout << position << std::endl;
     }
+    return turned;
 }
 
 void Snake::Player::turnRight() {
-    if (!isDying && !ca->isOnEdge(iPosition())) {
-        if (position[2] == 0) {
-            std::swap(velocity[0], velocity[1]);
-            velocity[1] = -velocity[1];
-        } else if (position[2] == VIRTUALCUBEMAXINDEX) {
-            std::swap(velocity[0], velocity[1]);
-            velocity[0] = -velocity[0];
-        } else if (position[1] == 0) {
-            std::swap(velocity[0], velocity[2]);
-            velocity[0] = -velocity[0];
-        } else if (position[1] == VIRTUALCUBEMAXINDEX) {
-            std::swap(velocity[0], velocity[2]);
-            velocity[2] = -velocity[2];
-        } else if (position[0] == 0) {
-            std::swap(velocity[1], velocity[2]);
-            velocity[2] = -velocity[2];
-        } else if (position[0] == VIRTUALCUBEMAXINDEX) {
-            std::swap(velocity[1], velocity[2]);
-            velocity[1] = -velocity[1];
-        }
+    if (!isDying && !ca->isOnEdge(iPosition()))
+        velocity = turnedRight();
+}
+
+Vector3f Snake::Player::turnedRight() {
+    Vector3f turned = velocity;
+    if (position[2] == 0) {
+        std::swap(turned[0], turned[1]);
+        turned[1] = -turned[1];
+    } else if (position[2] == VIRTUALCUBEMAXINDEX) {
+        std::swap(turned[0], turned[1]);
+        turned[0] = -turned[0];
+    } else if (position[1] == 0) {
+        std::swap(turned[0], turned[2]);
+        turned[0] = -turned[0];
+    } else if (position[1] == VIRTUALCUBEMAXINDEX) {
+        std::swap(turned[0], turned[2]);
+        turned[2] = -turned[2];
+    } else if (position[0] == 0) {
+        std::swap(turned[1], turned[2]);
+        turned[2] = -turned[2];
+    } else if (position[0] == VIRTUALCUBEMAXINDEX) {
+        std::swap(turned[1], turned[2]);
+        turned[1] = -turned[1];
     }
+    return turned;
 }
 
-bool Snake::Player::collidesWith(Vector3i point) {
-    for (auto t : tail)
-        if (t.cast<int>() == point)
-            return true;
-    return false;
+int Snake::Player::cellOf(const Vector3f &point) {
+    return SurfaceIndex::instance().indexOf(point.cast<int>());
 }
 
 void Snake::Player::grow(unsigned int howMuch) {
     snakeLength += howMuch;
+    //the tail holds one cell more than snakeLength until it is capped
+    tail.reserve(snakeLength + 1);
 }
 
 void Snake::Player::speedUp(float factor) {
@@ -387,13 +580,20 @@ Vector3i Snake::Player::iPosition() {
     return Vector3i(round(position[0]), round(position[1]), round(position[2]));
 }
 
+int Snake::Player::headCell() {
+    return tail.empty() ? -1 : tail.back();
+}
+
+int Snake::Player::getId() {
+    return id;
+}
+
 Color Snake::Player::getDefaultColor() {
     return defaultColor;
 };
 
 
 Snake::Food::Food(CubeApplication *renderCube, Vector3i setPosition, Color setColor) {
-    isEaten = false;
     position = setPosition;
     color = setColor;
     ca = renderCube;
@@ -407,14 +607,242 @@ Color Snake::Food::getColor() {
     return color;
 }
 
-bool Snake::Food::getIsEaten() {
-    return isEaten;
+void Snake::Food::render() {
+    ca->setPixel3D(position, color);
+}
+
+
+Snake::Grid::Grid(FreeCells *freeCells) {
+    freeCells_ = freeCells;
+    const int cells = SurfaceIndex::instance().size();
+    cells_.assign(cells, Occupant{-1, 0});
+    shared_.assign(cells, 0);
 }
 
-void Snake::Food::eat() {
-    isEaten = true;
+void Snake::Grid::add(int cell, int player) {
+    if (cell < 0)
+        return;
+    Occupant &top = cells_[cell];
+    if (top.count == 0)
+        freeCells_->block(cell);
+    if (top.count == 0 || top.player == player) {
+        top = Occupant{(int16_t) player, (uint16_t) (top.count + 1)};
+        return;
+    }
+    //the newest segment stays on top, an older player moves to the overflow
+    Occupant older = top;
+    top = Occupant{(int16_t) player, (uint16_t) (count(cell, player) + 1)};
+    for (size_t i = 0; i < overflow_.size(); i++) {
+        if (overflow_[i].cell == cell && overflow_[i].occupant.player == player) {
+            overflow_[i] = overflow_.back();
+            overflow_.pop_back();
+            shared_[cell]--;
+            break;
+        }
+    }
+    overflow_.push_back(SharedOccupant{(uint16_t) cell, older});
+    shared_[cell]++;
 }
 
-void Snake::Food::render() {
-    ca->setPixel3D(position, color);
+void Snake::Grid::remove(int cell, int player) {
+    if (cell < 0)
+        return;
+    Occupant &top = cells_[cell];
+    if (top.count > 0 && top.player == player) {
+        if (--top.count > 0)
+            return;
+        top.player = -1;
+        if (shared_[cell] == 0) {
+            freeCells_->unblock(cell);
+            return;
+        }
+        //one of the others takes over
+        size_t next = 0;
+        while (overflow_[next].cell != cell)
+            next++;
+        top = overflow_[next].occupant;
+        overflow_[next] = overflow_.back();
+        overflow_.pop_back();
+        shared_[cell]--;
+        return;
+    }
+    for (size_t i = 0; i < overflow_.size() && shared_[cell] > 0; i++) {
+        if (overflow_[i].cell == cell && overflow_[i].occupant.player == player) {
+            if (--overflow_[i].occupant.count == 0) {
+                overflow_[i] = overflow_.back();
+                overflow_.pop_back();
+                shared_[cell]--;
+            }
+            return;
+        }
+    }
+}
+
+int Snake::Grid::count(int cell, int player) {
+    const Occupant &top = cells_[cell];
+    if (top.count > 0 && top.player == player)
+        return top.count;
+    if (shared_[cell] > 0) {
+        for (const SharedOccupant &shared : overflow_)
+            if (shared.cell == cell && shared.occupant.player == player)
+                return shared.occupant.count;
+    }
+    return 0;
+}
+
+int Snake::Grid::owner(int cell) {
+    return cells_[cell].count > 0 ? cells_[cell].player : -1;
+}
+
+int Snake::Grid::other(int cell, int player) {
+    const Occupant &top = cells_[cell];
+    if (top.count > 0 && top.player != player)
+        return top.player;
+    //the overflow never holds the player on top
+    if (shared_[cell] > 0) {
+        for (const SharedOccupant &shared : overflow_)
+            if (shared.cell == cell)
+                return shared.occupant.player;
+    }
+    return -1;
+}
+
+Snake::Planner::Planner() {
+    const int n = SurfaceIndex::instance().size();
+    visited_.assign(n, 0);
+    parent_.resize(n);
+    queue_.reserve(n);
+    next_ = 0;
+    search_ = 0;
+    searching_ = false;
+}
+
+void Snake::Planner::start(int cell, int backward) {
+    if (++search_ == 0) {
+        std::fill(visited_.begin(), visited_.end(), 0);
+        search_ = 1;
+    }
+    queue_.clear();
+    queue_.push_back((uint16_t) cell);
+    visited_[cell] = search_;
+    next_ = 0;
+    backward_ = backward;
+    searching_ = true;
+    path_.clear();
+}
+
+bool Snake::Planner::search(Grid *grid, const std::vector<int32_t> &foodAt, int &budget) {
+    const SurfaceIndex &surface = SurfaceIndex::instance();
+    while (next_ < queue_.size()) {
+        if (budget <= 0)
+            return false;
+        budget--;
+        const int i = queue_[next_++];
+        for (int d = 0; d < SurfaceIndex::directions; d++) {
+            //a snake can not reverse
+            if (next_ == 1 && d == backward_)
+                continue;
+            const int j = surface.neighbor(i, d);
+            if (j < 0 || visited_[j] == search_ || grid->owner(j) >= 0 || (surface.isEdge(i) && surface.isEdge(j)))
+                continue;
+            visited_[j] = search_;
+            parent_[j] = (uint16_t) i;
+            if (foodAt[j] >= 0) {
+                for (int k = j; k != queue_.front(); k = parent_[k])
+                    path_.push_back((uint16_t) k);
+                path_.push_back(queue_.front());
+                std::reverse(path_.begin(), path_.end());
+                searching_ = false;
+                return true;
+            }
+            queue_.push_back((uint16_t) j);
+        }
+    }
+    //nothing reachable
+    searching_ = false;
+    return true;
+}
+
+Snake::Tail::Tail() {
+    mask_ = 0;
+    first_ = 0;
+    size_ = 0;
+}
+
+void Snake::Tail::reserve(unsigned int length) {
+    if (length <= cells_.size())
+        return;
+    unsigned int capacity = std::max<unsigned int>((unsigned int) cells_.size(), 16);
+    while (capacity < length)
+        capacity *= 2;
+    //unwrap into the new buffer, the oldest cell moves to the front
+    std::vector<uint16_t> cells(capacity);
+    for (unsigned int i = 0; i < size_; i++)
+        cells[i] = (uint16_t) (*this)[i];
+    cells_.swap(cells);
+    mask_ = capacity - 1;
+    first_ = 0;
+}
+
+void Snake::Tail::push(int cell) {
+    reserve(size_ + 1);
+    cells_[(first_ + size_) & mask_] = (uint16_t) cell;
+    size_++;
+}
+
+void Snake::Tail::pop() {
+    first_ = (first_ + 1) & mask_;
+    size_--;
+}
+
+void Snake::Tail::clear() {
+    first_ = 0;
+    size_ = 0;
+}
+
+Snake::FreeCells::FreeCells() {
+    const SurfaceIndex &surface = SurfaceIndex::instance();
+    const int n = surface.size();
+    cells_.resize(n);
+    slot_.resize(n);
+    blocked_.assign(n, 0);
+    for (int i = 0; i < n; i++) {
+        cells_[i] = (uint16_t) i;
+        slot_[i] = i;
+    }
+    free_ = n;
+    for (int i = 0; i < n; i++) {
+        if (surface.isEdge(i))
+            block(i);
+    }
+}
+
+void Snake::FreeCells::block(int cell) {
+    if (blocked_[cell]++ > 0)
+        return;
+    //swap with the last free cell
+    int last = cells_[free_ - 1];
+    cells_[slot_[cell]] = (uint16_t) last;
+    slot_[last] = slot_[cell];
+    cells_[free_ - 1] = (uint16_t) cell;
+    slot_[cell] = free_ - 1;
+    free_--;
+}
+
+void Snake::FreeCells::unblock(int cell) {
+    if (--blocked_[cell] > 0)
+        return;
+    //swap with the first blocked cell
+    int first = cells_[free_];
+    cells_[slot_[cell]] = (uint16_t) first;
+    slot_[first] = slot_[cell];
+    cells_[free_] = (uint16_t) cell;
+    slot_[cell] = free_;
+    free_++;
+}
+
+int Snake::FreeCells::sample() const {
+    if (free_ == 0)
+        return -1;
+    return cells_[FastRandom::below(free_)];
 }
@@ -2,7 +2,12 @@
 #define __SNAKE_H__
 
 #include <CubeApplication.h>
-#include <Joystick.h>
+#include "JoystickInput.h"
+#include "FixedTimestep.h"
+#include "SurfaceIndex.h"
+#include "HighScoreStore.h"
+#include "WorkerPool.h"
+#include "FastRandom.h"
 
 #define DEFAULTHIGHSCOREFILE "/home/pi/.snakehighscore"
 
@@ -14,37 +19,206 @@ public:
 
 private:
 
-    bool updateHighScoreFromToFile(int score = 0, std::string filename = DEFAULTHIGHSCOREFILE);
-
     class Player;
 
     class Food;
 
-    std::vector<Joystick *> joysticks;
+    class Grid;
+
+    class Tail;
+
+    class FreeCells;
+
+    class Planner;
+
+    /// a head entering a cell during a frame, time in ticks since the frame start
+    struct Crossing {
+        float time;
+        int16_t player;
+        uint16_t cell;
+    };
+
+    /// puts a pellet on a random free cell, of screen unless it is anyScreen
+    void spawnFood(ScreenNumber screen = anyScreen);
+
+    void eatFood(int cell);
+
+    /// a head moved into cell: kills a snake on another one and eats food, false if player died
+    bool headEntered(Player *player, int cell);
+
+    /// enters the cells the snakes crossed in step() into the grid, in the order of time and on a tie of player id
+    void commitCrossings();
+
+    std::vector<JoystickInput *> joysticks;
     std::vector<Player *> players;
-    std::vector<Food *> food;
+    std::vector<Food> food;
+    /// index into food for every surface cell, -1 without food
+    std::vector<int32_t> foodAt;
+
+    HighScoreStore highScores;
+    bool highScoreTime;
+    Color highScoreColor;
+    FixedTimestep timestep;
+    Grid *grid;
+    FreeCells *freeCells;
+    WorkerPool workers;
+    std::vector<Crossing> crossings;
+};
+
+/// Which snake occupies each surface voxel, so a collision check is one lookup instead of a walk along a tail.
+/// A cell remembers the player of its newest segment and how many segments that player has on it. Snakes overlap
+/// only around a dying snake, the other players on a cell are kept in a short overflow list that is only searched
+/// for shared cells.
+class Snake::Grid {
+public:
+    explicit Grid(FreeCells *freeCells);
+
+    /// one more segment of player on cell
+    void add(int cell, int player);
+    /// one segment less of player on cell
+    void remove(int cell, int player);
+
+    /// number of segments of player on cell
+    int count(int cell, int player);
+    /// player on top of cell, the one of the newest segment unless it left again, -1 if free
+    int owner(int cell);
+    /// a player other than player on cell, -1 if there is none
+    int other(int cell, int player);
+
+private:
+    struct Occupant {
+        int16_t player;
+        uint16_t count;
+    };
+
+    struct SharedOccupant {
+        uint16_t cell;
+        Occupant occupant;
+    };
+
+    std::vector<Occupant> cells_;
+    /// number of entries of a cell in shared_
+    std::vector<uint8_t> shared_;
+    std::vector<SharedOccupant> overflow_;
+    FreeCells *freeCells_;
+};
+
+/// The screen cells without a snake or food on them, so food is placed on a free cell in O(1).
+/// The free cells are kept packed at the front of an array, a cell knows its slot in it.
+/// Every occupant blocks a cell once, it is free again when the last one unblocks it. Edge cells are never free.
+class Snake::FreeCells {
+public:
+    FreeCells();
+
+    void block(int cell);
+    void unblock(int cell);
+
+    bool isFree(int cell) const { return blocked_[cell] == 0; }
+    int size() const { return free_; }
+    /// random free cell, -1 if the surface is full
+    int sample() const;
+
+private:
+    std::vector<uint16_t> cells_;
+    std::vector<int32_t> slot_;
+    std::vector<uint16_t> blocked_;
+    int free_;
+};
+
+/// The surface cells of a snake from the oldest to the head, in a ring buffer of surface indices.
+/// Appending the head and dropping the oldest cell are O(1), the buffer doubles when the snake outgrows it.
+class Snake::Tail {
+public:
+    Tail();
+
+    /// capacity for at least length cells
+    void reserve(unsigned int length);
+
+    void push(int cell);
+    /// drops the oldest cell
+    void pop();
+    void clear();
+
+    unsigned int size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    /// i-th cell, 0 is the oldest
+    int operator[](unsigned int i) const { return cells_[(first_ + i) & mask_]; }
+    int front() const { return cells_[first_]; }
+    int back() const { return cells_[(first_ + size_ - 1) & mask_]; }
 
-    int currentHighScore;
+private:
+    std::vector<uint16_t> cells_;
+    unsigned int mask_;
+    unsigned int first_;
+    unsigned int size_;
+};
+
+/// Breadth first search over the surface graph from a snake's head to the nearest food, around occupied cells.
+/// search() stops when its budget of expanded cells is spent and continues where it left off on the next call,
+/// so a long search is spread over several frames. Paths only cross an edge between two faces, never run along it.
+class Snake::Planner {
+public:
+    Planner();
+
+    /// a new search from cell, its neighbor in direction backward is left out
+    void start(int cell, int backward);
+    /// expands at most budget cells and takes them off it, true once the search has ended.
+    /// A count instead of a time keeps the game the same on every machine
+    bool search(Grid *grid, const std::vector<int32_t> &foodAt, int &budget);
+    bool isSearching() const { return searching_; }
+    /// from the start cell to the food, empty if no food is reachable
+    const std::vector<uint16_t> &path() const { return path_; }
+
+private:
+    /// number of the search that reached a cell
+    std::vector<uint32_t> visited_;
+    std::vector<uint16_t> parent_;
+    std::vector<uint16_t> queue_;
+    size_t next_;
+    int backward_;
+    uint32_t search_;
+    bool searching_;
+    std::vector<uint16_t> path_;
 };
 
 class Snake::Player {
 public:
-    Player(CubeApplication *renderCube, int joysticknumber, Vector3f position, Vector3f velocity, Color color,
+    /// the id is the joystick number and the index in Snake::players
+    Player(Snake *game, int joysticknumber, Vector3f position, Vector3f velocity, Color color,
            unsigned int length);
 
     void reset();
 
-    void step();
+    /// advances the head by ticks of movement in one go, cell by cell, so a fast snake never skips one.
+    /// Runs on a worker thread: the grid and food are only read, the cells the head crossed are collected
+    /// for Snake::commitCrossings()
+    void step(int ticks);
+
+    /// cells the head crossed in the last step()
+    const std::vector<Crossing> &getCrossed();
+
+    /// the head entered a cell: grows the tail, checks collisions and food
+    void enterCell(int cell);
 
-    void accelerate();
+    void accelerate(int ticks);
 
-    void move();
+    void move(float ticks);
 
     void warp();
 
     void handleJoystick();
 
-    void doKiMove();
+    /// true without a joystick, the snake is steered by doKiMove()
+    bool isKi();
+
+    /// steers along a path from head to the nearest food, CUBE_SNAKE_KI_BUDGET=0 turns at random instead
+    void doKiMove(int head);
+
+    /// refills the search budget, once per frame
+    void newFrame();
+
+    /// moves along the planned path to the head, true if the rest of it is still free and leads to food
+    bool followPath(int head);
 
     void render();
 
@@ -52,7 +226,19 @@ public:
 
     void turnRight();
 
-    bool collidesWith(Vector3i point);
+    /// velocity after a left or right turn on the current face
+    Vector3f turnedLeft();
+
+    Vector3f turnedRight();
+
+    /// turns towards a SurfaceIndex direction
+    void steer(int direction);
+
+    /// SurfaceIndex direction of a velocity
+    static int directionOf(const Vector3f &velocity);
+
+    /// surface cell of a position
+    static int cellOf(const Vector3f &point);
 
     void grow(unsigned int howMuch);
 
@@ -66,12 +252,23 @@ public:
 
     Vector3i iPosition();
 
+    /// surface cell of the head, -1 before the first step
+    int headCell();
+
+    int getId();
+
     int getSnakeLength();
 
     Color getDefaultColor();
 
 private:
-    std::vector<Vector3f> tail;
+    /// notes the cell of the head if it is a new one
+    void cross(float time);
+
+    /// head cell including the cells crossed in this frame
+    int frameHead();
+
+    Tail tail;
     Vector3f position;
     Vector3f velocity;
     Vector3f acceleration;
@@ -89,9 +286,21 @@ private:
     unsigned int defaultSnakeLength;
     EdgeNumber lastEdge;
     Vector3i lastIPosition;
-    Joystick joystick;
+    JoystickInput *joystick;
     float lastAxis0;
     CubeApplication *ca;
+    Snake *game;
+    Grid *grid;
+    int id;
+    Planner planner;
+    /// cells the search expands per frame and what is left of them
+    int kiBudget;
+    int kiBudgetLeft;
+    /// index of the head in the planned path
+    unsigned int kiPathStep;
+    /// random turns, a generator per snake does not depend on the thread that steps it
+    FastRandom::Generator kiRandom;
+    std::vector<Crossing> crossed;
 };
 
 class Snake::Food {
@@ -102,14 +311,9 @@ public:
 
     Color getColor();
 
-    bool getIsEaten();
-
-    void eat();
-
     void render();
 
 protected:
-    bool isEaten;
     Vector3i position;
     Color color;
     CubeApplication *ca;